@@ -0,0 +1,245 @@
+#include "Binaries.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Gravity.h"
+#include "Morton.h"
+#include "WisdomHolman.h"
+
+HardBinaries::HardBinaries(double hard_radius, double perturber_radius) {
+  this->hard_radius = hard_radius;
+  this->perturber_radius = perturber_radius;
+}
+
+// Cells shifted to positive coordinates, anything beyond 2^31 cells shares the edge ones
+static inline uint32_t gridCell(double coordinate, double cell_size) {
+  double cell = floor(coordinate / cell_size) + 2147483648.0;
+  return static_cast<uint32_t>(fmin(fmax(cell, 0.0), 4294967295.0));
+}
+
+// Farthest distance of the relative orbit, infinite for unbound ones
+static double apocentreOf(double mu, Vector2d z, Vector2d v) {
+  double r = z.length();
+  double energy = (v.x * v.x + v.y * v.y) / 2 - mu / r;
+
+  if (r == 0.0 || energy >= 0.0) {
+    return INFINITY;
+  }
+
+  double semi_major = -mu / (2 * energy);
+
+  // |z x v|^2 = mu a (1 - e^2)
+  double cross = z.x * v.y - z.y * v.x;
+  double eccentricity = sqrt(fmax(0.0, 1.0 - cross * cross / (mu * semi_major)));
+
+  return semi_major * (1 + eccentricity);
+}
+
+void HardBinaries::buildGrid(std::vector<Planet> const& planets) {
+  size_t count = planets.size();
+
+  keys.resize(count);
+  indices.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    Vector2d position = Vector2d(planets[i].position);
+
+    keys[i] = mortonKey(gridCell(position.x, perturber_radius), gridCell(position.y, perturber_radius));
+    indices[i] = static_cast<uint32_t>(i);
+  }
+
+  radixSort(keys, indices, key_scratch, index_scratch);
+}
+
+template <typename F>
+void HardBinaries::forEachNeighbour(Vector2d position, F const& fn) const {
+  uint32_t cell_x = gridCell(position.x, perturber_radius);
+  uint32_t cell_y = gridCell(position.y, perturber_radius);
+
+  for (int32_t dy = -1; dy <= 1; ++dy) {
+    for (int32_t dx = -1; dx <= 1; ++dx) {
+      auto range = std::equal_range(keys.begin(), keys.end(), mortonKey(cell_x + dx, cell_y + dy));
+
+      for (auto it = range.first; it != range.second; ++it) {
+        fn(indices[it - keys.begin()]);
+      }
+    }
+  }
+}
+
+double HardBinaries::perturbation(std::vector<Planet> const& planets, uint32_t first, uint32_t second, Vector2d center, double mass, double apocentre) const {
+  double tidal = 0.0;
+
+  // Tidal acceleration 2 G m a / d^3 against the pair's G M / a^2
+  forEachNeighbour(center, [&](uint32_t k) {
+    if (k == first || k == second || planets[k].isTracer()) {
+      return;
+    }
+
+    double distance = (Vector2d(planets[k].position) - center).length();
+
+    if (distance < perturber_radius) {
+      tidal += 2 * planets[k].mass * apocentre * apocentre * apocentre / (distance * distance * distance);
+    }
+  });
+
+  return tidal / mass;
+}
+
+void HardBinaries::merge(std::vector<Planet>& planets, MortonOrder& order) {
+  size_t count = planets.size();
+
+  order.track(count);
+
+  in_binary.assign(count, false);
+
+  if (count < 2) {
+    binaries.clear();
+    return;
+  }
+
+  buildGrid(planets);
+
+  auto centerOf = [&](uint32_t first, uint32_t second) {
+    double m1 = planets[first].mass, m2 = planets[second].mass;
+    return (Vector2d(planets[first].position) * m1 + Vector2d(planets[second].position) * m2) / (m1 + m2);
+  };
+
+  // Apocentre of the pair, infinite when it is not a bound pair of massive planets
+  auto pairApocentre = [&](uint32_t first, uint32_t second) {
+    Planet const& a = planets[first];
+    Planet const& b = planets[second];
+
+    if (a.isTracer() || b.isTracer()) {
+      return double(INFINITY);
+    }
+
+    Vector2d z = Vector2d(b.position) - Vector2d(a.position);
+    Vector2d v = Vector2d(b.velocity) / double(b.mass) - Vector2d(a.velocity) / double(a.mass);
+
+    return apocentreOf(G * (double(a.mass) + double(b.mass)), z, v);
+  };
+
+  // Planets hold the members' real state between ticks, splitting is just forgetting the binary
+  binaries.erase(std::remove_if(binaries.begin(), binaries.end(), [&](Binary const& binary) {
+    if (binary.first >= count || binary.second >= count) {
+      return true;
+    }
+
+    uint32_t first = order.slots[binary.first];
+    uint32_t second = order.slots[binary.second];
+
+    double apocentre = pairApocentre(first, second);
+
+    if (apocentre >= hard_radius) {
+      return true;
+    }
+
+    double mass = double(planets[first].mass) + double(planets[second].mass);
+
+    return perturbation(planets, first, second, centerOf(first, second), mass, apocentre) > max_perturbation;
+  }), binaries.end());
+
+  for (Binary const& binary : binaries) {
+    in_binary[order.slots[binary.first]] = in_binary[order.slots[binary.second]] = true;
+  }
+
+  // New binaries among the single planets
+  candidates.clear();
+
+  for (uint32_t i = 0; i < count; ++i) {
+    Planet const& planet = planets[i];
+
+    if (planet.isTracer() || in_binary[i]) {
+      continue;
+    }
+
+    forEachNeighbour(Vector2d(planet.position), [&](uint32_t j) {
+      if (j <= i || in_binary[j]) {
+        return;
+      }
+
+      double apocentre = pairApocentre(i, j);
+
+      if (apocentre < hard_radius) {
+        candidates.push_back({ i, j, apocentre });
+      }
+    });
+  }
+
+  std::sort(candidates.begin(), candidates.end(), [](Candidate const& a, Candidate const& b) {
+    return a.apocentre < b.apocentre;
+  });
+
+  for (Candidate const& candidate : candidates) {
+    if (in_binary[candidate.first] || in_binary[candidate.second]) {
+      continue;
+    }
+
+    double mass = double(planets[candidate.first].mass) + double(planets[candidate.second].mass);
+    Vector2d center = centerOf(candidate.first, candidate.second);
+
+    if (perturbation(planets, candidate.first, candidate.second, center, mass, candidate.apocentre) > max_perturbation) {
+      continue;
+    }
+
+    in_binary[candidate.first] = in_binary[candidate.second] = true;
+
+    Binary binary;
+    binary.first = order.ids[candidate.first];
+    binary.second = order.ids[candidate.second];
+    binaries.push_back(binary);
+  }
+
+  // Replace by the centre of mass
+  for (Binary& binary : binaries) {
+    uint32_t first_slot = order.slots[binary.first];
+    uint32_t second_slot = order.slots[binary.second];
+
+    Planet& first = order.planet(planets, binary.first);
+    Planet& second = order.planet(planets, binary.second);
+
+    binary.masses[0] = first.mass;
+    binary.masses[1] = second.mass;
+
+    double mass = binary.masses[0] + binary.masses[1];
+
+    binary.separation = Vector2d(second.position) - Vector2d(first.position);
+    binary.relative_velocity = Vector2d(second.velocity) / binary.masses[1] - Vector2d(first.velocity) / binary.masses[0];
+
+    first.position = PositionVector(centerOf(first_slot, second_slot));
+    first.velocity = first.velocity + second.velocity;
+    first.mass = StateScalar(mass);
+
+    second.position = first.position;
+    second.velocity = StateVector();
+    second.mass = StateScalar(0);
+  }
+}
+
+void HardBinaries::split(std::vector<Planet>& planets, MortonOrder const& order) {
+  for (Binary& binary : binaries) {
+    Planet& first = order.planet(planets, binary.first);
+    Planet& second = order.planet(planets, binary.second);
+
+    double m1 = binary.masses[0], m2 = binary.masses[1];
+    double mass = m1 + m2;
+
+    keplerDrift(G * mass, binary.separation, binary.relative_velocity, 1.0);
+
+    // The first member went through the tick as the centre of mass
+    Vector2d center = Vector2d(first.position);
+    Vector2d velocity = Vector2d(first.velocity) / mass;
+
+    first.mass = StateScalar(m1);
+    second.mass = StateScalar(m2);
+
+    first.position = PositionVector(center - binary.separation * (m2 / mass));
+    second.position = PositionVector(center + binary.separation * (m1 / mass));
+
+    first.velocity = StateVector((velocity - binary.relative_velocity * (m2 / mass)) * m1);
+    second.velocity = StateVector((velocity + binary.relative_velocity * (m1 / mass)) * m2);
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Morton.h"
+#include "Planet.h"
+
+// Hard binaries: bound pairs far tighter than their surroundings. While the tidal pull of their
+// neighbours stays below max_perturbation of the pair's own pull, the global force calculation
+// only sees their centre of mass and the inner orbit is advanced analytically with keplerDrift().
+// Binaries that get perturbed are split back into two planets
+class HardBinaries {
+public:
+  struct Binary {
+    uint32_t first, second; // MortonOrder ids, binaries outlive reorders
+    double   masses[2];
+    Vector2d separation;        // second - first
+    Vector2d relative_velocity;
+  };
+
+  std::vector<Binary> binaries;
+
+  double hard_radius;             // pixels, apocentre of the widest orbit merged
+  double perturber_radius;        // pixels, neighbours farther away are ignored
+  double max_perturbation = 1e-3; // tidal pull over the pair's own pull
+
+  // Neighbour search on a grid of perturber_radius cells
+  std::vector<uint64_t> keys, key_scratch;
+  std::vector<uint32_t> indices, index_scratch;
+
+  struct Candidate {
+    uint32_t first, second;
+    double   apocentre;
+  };
+
+  std::vector<Candidate> candidates;
+  std::vector<bool> in_binary;
+
+public:
+  HardBinaries(double hard_radius = 5.0, double perturber_radius = 100.0);
+
+public:
+  // Splits perturbed binaries, finds new ones and replaces every binary by its centre of mass:
+  // the first member carries the total mass, the second becomes a tracer. Call before the kicks
+  void merge(std::vector<Planet>& planets, MortonOrder& order);
+
+  // Moves the inner orbits on by one tick and puts both members back
+  void split(std::vector<Planet>& planets, MortonOrder const& order);
+
+private:
+  void buildGrid(std::vector<Planet> const& planets);
+
+  // Tidal pull on an orbit of size apocentre around center over the pair's own pull
+  double perturbation(std::vector<Planet> const& planets, uint32_t first, uint32_t second, Vector2d center, double mass, double apocentre) const;
+
+  template <typename F>
+  void forEachNeighbour(Vector2d position, F const& fn) const;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Vector.h"
+
+// Unevaluated sum hi + lo of two floats, about 48 bits of mantissa using float arithmetic only.
+// Built from error-free transformations, so it must not be compiled with -ffast-math.
+struct DoubleFloat {
+  float hi, lo;
+
+  constexpr DoubleFloat()
+    : hi(0), lo(0) {}
+
+  constexpr DoubleFloat(float hi, float lo)
+    : hi(hi), lo(lo) {}
+
+  constexpr DoubleFloat(double v)
+    : hi(static_cast<float>(v)), lo(static_cast<float>(v - static_cast<float>(v))) {}
+
+  explicit constexpr operator double() const noexcept {
+    return static_cast<double>(hi) + static_cast<double>(lo);
+  }
+
+  // a + b == s + e exactly (Knuth)
+  static inline DoubleFloat twoSum(float a, float b) noexcept {
+    float s = a + b;
+    float v = s - a;
+    float e = (a - (s - v)) + (b - v);
+    return DoubleFloat( s, e );
+  }
+
+  // Same as twoSum, requires |a| >= |b|
+  static inline DoubleFloat quickTwoSum(float a, float b) noexcept {
+    float s = a + b;
+    float e = b - (s - a);
+    return DoubleFloat( s, e );
+  }
+
+  inline DoubleFloat& operator+=(DoubleFloat const& v) noexcept {
+    DoubleFloat s = twoSum(hi, v.hi);
+    DoubleFloat t = twoSum(lo, v.lo);
+
+    s = quickTwoSum(s.hi, s.lo + t.hi);
+    *this = quickTwoSum(s.hi, s.lo + t.lo);
+
+    return *this;
+  }
+
+  inline DoubleFloat operator+(DoubleFloat const& v) const noexcept {
+    DoubleFloat result = *this;
+    return result += v;
+  }
+
+  inline DoubleFloat& operator-=(DoubleFloat const& v) noexcept {
+    return *this += -v;
+  }
+
+  inline DoubleFloat operator-(DoubleFloat const& v) const noexcept {
+    DoubleFloat result = *this;
+    return result -= v;
+  }
+
+  constexpr DoubleFloat operator-() const noexcept {
+    return DoubleFloat( -hi, -lo );
+  }
+
+  // Difference rounded to float. Nearby values share most of hi, so (to.hi - hi) is exact
+  // and the result keeps the full precision of the offset between them.
+  inline float difference(DoubleFloat const& to) const noexcept {
+    return (to.hi - hi) + (to.lo - lo);
+  }
+};
+
+struct DFVector2 {
+  DoubleFloat x, y;
+
+  constexpr DFVector2()
+    : x(), y() {}
+
+  constexpr DFVector2(DoubleFloat x, DoubleFloat y)
+    : x(x), y(y) {}
+
+  template <typename T>
+  constexpr DFVector2(TVector2<T> const& v)
+    : x(static_cast<double>(v.x)), y(static_cast<double>(v.y)) {}
+
+  template <typename T>
+  explicit constexpr operator TVector2<T>() const noexcept {
+    return TVector2<T>( static_cast<T>(static_cast<double>(x)), static_cast<T>(static_cast<double>(y)) );
+  }
+
+  inline DFVector2& operator+=(DFVector2 const& v) noexcept {
+    x += v.x; y += v.y;
+    return *this;
+  }
+
+  inline DFVector2& operator-=(DFVector2 const& v) noexcept {
+    x -= v.x; y -= v.y;
+    return *this;
+  }
+
+  // Differences between positions are small, so they are returned in plain float
+  inline Vector2 operator-(DFVector2 const& v) const noexcept {
+    return Vector2( v.x.difference(x), v.y.difference(y) );
+  }
+
+  inline bool operator==(DFVector2 const& other) const noexcept {
+    return
+      x.hi == other.x.hi && x.lo == other.x.lo &&
+      y.hi == other.y.hi && y.lo == other.y.lo;
+  }
+};
@@ -0,0 +1,158 @@
+#include "Ensemble.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+#include "Parallel.h"
+
+Ensemble::Ensemble(size_t planet_count, size_t member_count) {
+  this->planet_count = planet_count;
+  this->member_count = member_count;
+
+  size_t size = planet_count * member_count;
+
+  x.assign(size, StateScalar(0));
+  y.assign(size, StateScalar(0));
+  px.assign(size, StateScalar(0));
+  py.assign(size, StateScalar(0));
+  mass.assign(size, StateScalar(1));
+
+  min_distance2.assign(member_count, ForceScalar(INFINITY));
+  initial_energy.assign(member_count, 0.0);
+  ticks.assign(member_count, 0);
+}
+
+bool Ensemble::set(size_t member, std::vector<Planet> const& planets) {
+  for (size_t i = 0; i < planet_count; ++i) {
+    if (planets[i].isTracer()) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < planet_count; ++i) {
+    size_t index = i * member_count + member;
+    Vector2d position = Vector2d(planets[i].position);
+
+    x[index] = StateScalar(position.x);
+    y[index] = StateScalar(position.y);
+    px[index] = planets[i].velocity.x;
+    py[index] = planets[i].velocity.y;
+    mass[index] = planets[i].mass;
+  }
+
+  min_distance2[member] = ForceScalar(INFINITY);
+  initial_energy[member] = energy(member);
+  ticks[member] = 0;
+
+  return true;
+}
+
+void Ensemble::get(size_t member, std::vector<Planet>& planets) const {
+  for (size_t i = 0; i < planet_count; ++i) {
+    size_t index = i * member_count + member;
+
+    planets[i].position = PositionVector(Vector2d(x[index], y[index]));
+    planets[i].velocity = StateVector(px[index], py[index]);
+  }
+}
+
+void Ensemble::tick(uint64_t count) {
+  parallelFor(member_count, [&](size_t begin, size_t end) {
+    for (uint64_t t = 0; t < count; ++t) {
+      tickRange(begin, end);
+    }
+
+    for (size_t m = begin; m < end; ++m) {
+      ticks[m] += count;
+    }
+  });
+}
+
+void Ensemble::tickRange(size_t begin, size_t end) {
+  size_t stride = member_count;
+
+  StateScalar* __restrict sx = x.data();
+  StateScalar* __restrict sy = y.data();
+  StateScalar* __restrict spx = px.data();
+  StateScalar* __restrict spy = py.data();
+  StateScalar const* __restrict sm = mass.data();
+  ForceScalar* __restrict closest = min_distance2.data();
+
+  for (size_t i = 0; i < planet_count; ++i) {
+    for (size_t j = i + 1; j < planet_count; ++j) {
+      size_t a = i * stride, b = j * stride;
+
+      #pragma omp simd
+      for (size_t m = begin; m < end; ++m) {
+        ForceScalar dx = ForceScalar(sx[b + m] - sx[a + m]);
+        ForceScalar dy = ForceScalar(sy[b + m] - sy[a + m]);
+
+        ForceScalar distance2 = dx * dx + dy * dy;
+        closest[m] = distance2 < closest[m] ? distance2 : closest[m];
+
+        // Coincident planets have no direction to pull in. A multiplied mask rather than a
+        // selected result, GCC doesn't if-convert the latter and leaves the loop scalar
+        ForceScalar pull = distance2 > ForceScalar(0) ? ForceScalar(1) : ForceScalar(0);
+
+        ForceScalar inv_distance = ForceScalar(1) / sqrt(distance2 + (ForceScalar(1) - pull));
+        ForceScalar force = pull * ForceScalar(G) * ForceScalar(sm[a + m]) * ForceScalar(sm[b + m]) * inv_distance * inv_distance * inv_distance;
+
+        StateScalar fx = StateScalar(dx * force);
+        StateScalar fy = StateScalar(dy * force);
+
+        spx[a + m] += fx;
+        spy[a + m] += fy;
+        spx[b + m] -= fx;
+        spy[b + m] -= fy;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < planet_count; ++i) {
+    size_t a = i * stride;
+
+    #pragma omp simd
+    for (size_t m = begin; m < end; ++m) {
+      sx[a + m] += spx[a + m] / sm[a + m];
+      sy[a + m] += spy[a + m] / sm[a + m];
+    }
+  }
+}
+
+double Ensemble::energy(size_t member) const {
+  double kinetic = 0.0, potential = 0.0;
+
+  for (size_t i = 0; i < planet_count; ++i) {
+    size_t a = i * member_count + member;
+
+    kinetic += 0.5 * (double(px[a]) * px[a] + double(py[a]) * py[a]) / mass[a];
+
+    for (size_t j = i + 1; j < planet_count; ++j) {
+      size_t b = j * member_count + member;
+
+      double distance = Vector2d(double(x[b]) - x[a], double(y[b]) - y[a]).length();
+
+      if (distance > 0.0) {
+        potential -= G * mass[a] * mass[b] / distance;
+      }
+    }
+  }
+
+  return kinetic + potential;
+}
+
+Ensemble::Diagnostics Ensemble::diagnostics(size_t member) const {
+  Diagnostics result;
+
+  result.energy = energy(member);
+  result.energy_error = initial_energy[member] != 0.0 ? (result.energy - initial_energy[member]) / fabs(initial_energy[member]) : 0.0;
+  result.min_distance = sqrt(double(min_distance2[member]));
+  result.ticks = ticks[member];
+
+  for (size_t i = 0; i < planet_count; ++i) {
+    size_t a = i * member_count + member;
+    result.momentum += Vector2d(px[a], py[a]);
+  }
+
+  return result;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Planet.h"
+
+// M independent systems of the same N planets integrated in lockstep. Every array is
+// [planet * member_count + member], so the members of one planet are contiguous and the
+// force and drift loops run over members, one SIMD lane per system. Threads take disjoint
+// member ranges for all the requested ticks, systems never talk to each other.
+// A tick is the pairwise kick then drift of the Euler integrator. Tracers aren't supported,
+// the momenta are divided by mass
+class Ensemble {
+public:
+  struct Diagnostics {
+    double   energy;
+    double   energy_error; // relative to the energy when the member was set
+    Vector2d momentum;
+    double   min_distance; // closest approach of any pair since the member was set
+    uint64_t ticks;
+  };
+
+  size_t planet_count;
+  size_t member_count;
+
+  std::vector<StateScalar> x, y;
+  std::vector<StateScalar> px, py; // momenta, like Planet::velocity
+  std::vector<StateScalar> mass;
+
+  std::vector<ForceScalar> min_distance2;
+  std::vector<double>      initial_energy;
+  std::vector<uint64_t>    ticks;
+
+public:
+  Ensemble(size_t planet_count, size_t member_count);
+
+public:
+  // False, and the member left as it was, if any of the planets is a tracer
+  bool set(size_t member, std::vector<Planet> const& planets);
+  void get(size_t member, std::vector<Planet>& planets) const;
+
+  void tick(uint64_t count = 1);
+
+  Diagnostics diagnostics(size_t member) const;
+
+private:
+  void tickRange(size_t begin, size_t end);
+
+  double energy(size_t member) const;
+};
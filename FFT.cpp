@@ -0,0 +1,95 @@
+#include "FFT.h"
+
+#include <math.h>
+
+#include "Parallel.h"
+
+static constexpr double TWO_PI = 6.283185307179586;
+
+FFT::FFT(size_t size) {
+  this->size = size;
+
+  size_t bits = 0;
+  while ((size_t(1) << bits) < size) {
+    ++bits;
+  }
+
+  bit_reverse.resize(size);
+  for (size_t i = 0; i < size; ++i) {
+    size_t reversed = 0;
+
+    for (size_t bit = 0; bit < bits; ++bit) {
+      if (i & (size_t(1) << bit)) {
+        reversed |= size_t(1) << (bits - 1 - bit);
+      }
+    }
+
+    bit_reverse[i] = reversed;
+  }
+
+  twiddles.resize(size / 2);
+  for (size_t k = 0; k < size / 2; ++k) {
+    double angle = -TWO_PI * k / size;
+    twiddles[k] = Complex(cos(angle), sin(angle));
+  }
+}
+
+void FFT::transform(Complex* data, bool inverse) const {
+  for (size_t i = 0; i < size; ++i) {
+    size_t j = bit_reverse[i];
+
+    if (i < j) {
+      std::swap(data[i], data[j]);
+    }
+  }
+
+  for (size_t length = 2; length <= size; length *= 2) {
+    size_t half = length / 2;
+    size_t twiddle_step = size / length;
+
+    for (size_t start = 0; start < size; start += length) {
+      for (size_t k = 0; k < half; ++k) {
+        Complex w = twiddles[k * twiddle_step];
+        if (inverse) {
+          w = std::conj(w);
+        }
+
+        Complex& a = data[start + k];
+        Complex& b = data[start + k + half];
+
+        // Spelled out, std::complex multiplication goes through the NaN-checking libcall
+        Complex t(
+          w.real() * b.real() - w.imag() * b.imag(),
+          w.real() * b.imag() + w.imag() * b.real()
+        );
+        b = a - t;
+        a += t;
+      }
+    }
+  }
+}
+
+void FFT::transform2D(Complex* data, bool inverse) const {
+  parallelFor(size, [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; ++row) {
+      transform(data + row * size, inverse);
+    }
+  });
+
+  // Columns go through a contiguous copy, strided butterflies thrash the cache
+  parallelFor(size, [&](size_t begin, size_t end) {
+    std::vector<Complex> column(size);
+
+    for (size_t col = begin; col < end; ++col) {
+      for (size_t row = 0; row < size; ++row) {
+        column[row] = data[row * size + col];
+      }
+
+      transform(column.data(), inverse);
+
+      for (size_t row = 0; row < size; ++row) {
+        data[row * size + col] = column[row];
+      }
+    }
+  });
+}
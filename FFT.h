@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <complex>
+#include <vector>
+
+using Complex = std::complex<double>;
+
+// Radix-2 complex FFT of a fixed power of two size, tables are built once in the constructor
+class FFT {
+public:
+  size_t size;
+
+  std::vector<size_t> bit_reverse;
+  std::vector<Complex> twiddles; // exp(-2 pi i k / size), k < size / 2
+
+public:
+  FFT(size_t size = 1);
+
+public:
+  // In place, inverse transform is not normalised
+  void transform(Complex* data, bool inverse) const;
+
+  // In place transform of a size x size row-major grid, rows and columns run in parallel
+  void transform2D(Complex* data, bool inverse) const;
+};
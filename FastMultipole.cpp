@@ -0,0 +1,220 @@
+#include "FastMultipole.h"
+
+#include <math.h>
+
+#include "Parallel.h"
+
+FastMultipole::FastMultipole(uint32_t order, double theta)
+  : expansion(order)
+{
+  this->theta = theta;
+
+  tree.leaf_size = 16;
+}
+
+void FastMultipole::apply(std::vector<Planet>& planets) {
+  tree.build(planets);
+
+  if (tree.nodes.empty()) {
+    return;
+  }
+
+  size_t node_count = tree.nodes.size();
+  uint32_t terms = expansion.terms;
+
+  multipoles.assign(node_count * terms, 0.0);
+  locals.assign(node_count * terms, 0.0);
+  radii.assign(node_count, 0.0);
+  accelerations.assign(planets.size(), Vector2d());
+
+  upward(0);
+
+  // Independent target subtrees, each one traversed against the whole tree by one job.
+  // Interactions only ever write into the target side, so jobs don't overlap
+  std::vector<int32_t> tasks = { 0 };
+
+  while (tasks.size() < threadCount() * 4) {
+    std::vector<int32_t> split;
+
+    for (int32_t node : tasks) {
+      if (isLeaf(node)) {
+        split.push_back(node);
+        continue;
+      }
+
+      for (int32_t child : tree.nodes[node].children) {
+        if (child >= 0) {
+          split.push_back(child);
+        }
+      }
+    }
+
+    if (split.size() == tasks.size()) {
+      break;
+    }
+
+    tasks = std::move(split);
+  }
+
+  parallelFor(tasks.size(), [&](size_t begin, size_t end) {
+    for (size_t task = begin; task < end; ++task) {
+      interact(tasks[task], 0);
+      downward(tasks[task]);
+    }
+  });
+
+  parallelFor(planets.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      planets[i].punch(StateVector(accelerations[i] * double(planets[i].mass)));
+    }
+  });
+}
+
+void FastMultipole::upward(int32_t index) {
+  QuadTree::Node const& node = tree.nodes[index];
+  double* multipole = &multipoles[index * expansion.terms];
+
+  if (isLeaf(index)) {
+    double radius = 0.0;
+
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      uint32_t body = tree.order[i];
+      Vector2d offset = tree.positions[body] - node.mass_center;
+
+      expansion.addParticle(offset, tree.masses[body], multipole);
+      radius = fmax(radius, offset.length());
+    }
+
+    radii[index] = radius;
+    return;
+  }
+
+  double radius = 0.0;
+
+  for (int32_t child : node.children) {
+    if (child < 0) {
+      continue;
+    }
+
+    upward(child);
+
+    Vector2d shift = tree.nodes[child].mass_center - node.mass_center;
+
+    expansion.shiftMultipole(&multipoles[child * expansion.terms], shift, multipole);
+    radius = fmax(radius, shift.length() + radii[child]);
+  }
+
+  radii[index] = radius;
+}
+
+void FastMultipole::interact(int32_t target, int32_t source) {
+  QuadTree::Node const& a = tree.nodes[target];
+  QuadTree::Node const& b = tree.nodes[source];
+
+  bool target_leaf = isLeaf(target);
+  bool source_leaf = isLeaf(source);
+
+  if (target == source) {
+    if (target_leaf) {
+      interactLeaves(target, source);
+      return;
+    }
+
+    for (int32_t first : a.children) {
+      for (int32_t second : a.children) {
+        if (first >= 0 && second >= 0) {
+          interact(first, second);
+        }
+      }
+    }
+
+    return;
+  }
+
+  Vector2d separation = a.mass_center - b.mass_center;
+  double distance = separation.length();
+
+  if (radii[target] + radii[source] < theta * distance) {
+    expansion.multipoleToLocal(&multipoles[source * expansion.terms], separation, &locals[target * expansion.terms]);
+    return;
+  }
+
+  if (target_leaf && source_leaf) {
+    interactLeaves(target, source);
+    return;
+  }
+
+  // Split the bigger cell, an ancestor is never smaller than its descendants
+  bool split_target = source_leaf || (!target_leaf && radii[target] > radii[source]);
+
+  if (split_target) {
+    for (int32_t child : a.children) {
+      if (child >= 0) {
+        interact(child, source);
+      }
+    }
+  }
+  else {
+    for (int32_t child : b.children) {
+      if (child >= 0) {
+        interact(target, child);
+      }
+    }
+  }
+}
+
+void FastMultipole::interactLeaves(int32_t target, int32_t source) {
+  QuadTree::Node const& a = tree.nodes[target];
+  QuadTree::Node const& b = tree.nodes[source];
+
+  for (uint32_t i = a.first; i < a.first + a.count; ++i) {
+    uint32_t body = tree.order[i];
+    Vector2d position = tree.positions[body];
+    Vector2d acceleration;
+
+    for (uint32_t j = b.first; j < b.first + b.count; ++j) {
+      uint32_t other = tree.order[j];
+
+      if (other == body) {
+        continue;
+      }
+
+      Vector2d diff = tree.positions[other] - position;
+      double distance = diff.length();
+
+      // Coincident bodies have no direction to pull in
+      if (distance == 0.0) {
+        continue;
+      }
+
+      acceleration += diff * (G * tree.masses[other] / (distance * distance * distance));
+    }
+
+    accelerations[body] += acceleration;
+  }
+}
+
+void FastMultipole::downward(int32_t index) {
+  QuadTree::Node const& node = tree.nodes[index];
+  double const* local = &locals[index * expansion.terms];
+
+  if (isLeaf(index)) {
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      uint32_t body = tree.order[i];
+      accelerations[body] += expansion.localAcceleration(local, tree.positions[body] - node.mass_center);
+    }
+
+    return;
+  }
+
+  for (int32_t child : node.children) {
+    if (child < 0) {
+      continue;
+    }
+
+    Vector2d shift = tree.nodes[child].mass_center - node.mass_center;
+
+    expansion.shiftLocal(local, shift, &locals[child * expansion.terms]);
+    downward(child);
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Multipole.h"
+#include "QuadTree.h"
+
+// Fast multipole method on the quadtree with a dual-tree traversal.
+// Every cell carries a multipole and a local expansion of the same order about its centre of mass;
+// pairs of cells with (r_a + r_b) < theta * distance interact through one multipole-to-local
+// translation, touching leaves interact directly. Cost is O(N) for a fixed order, the error is set
+// by order and theta.
+class FastMultipole {
+public:
+  QuadTree tree;
+  Expansion expansion;
+
+  double theta;
+
+  std::vector<double> multipoles;      // expansion.terms per node
+  std::vector<double> locals;          // expansion.terms per node
+  std::vector<double> radii;           // per node, bodies are within radius of the centre of mass
+  std::vector<Vector2d> accelerations; // per body
+
+public:
+  FastMultipole(uint32_t order = 6, double theta = 0.5);
+
+public:
+  void apply(std::vector<Planet>& planets);
+
+private:
+  void upward(int32_t node);
+  void interact(int32_t target, int32_t source);
+  void interactLeaves(int32_t target, int32_t source);
+  void downward(int32_t node);
+
+  inline bool isLeaf(int32_t node) const noexcept {
+    QuadTree::Node const& n = tree.nodes[node];
+    return n.children[0] < 0 && n.children[1] < 0 && n.children[2] < 0 && n.children[3] < 0;
+  }
+};
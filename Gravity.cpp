@@ -0,0 +1,148 @@
+#include "Gravity.h"
+
+#include <math.h>
+
+#include "Parallel.h"
+
+void TracerGravity::split(std::vector<Planet> const& planets) {
+  massive.clear();
+  tracers.clear();
+
+  for (size_t i = 0; i < planets.size(); ++i) {
+    (planets[i].isTracer() ? tracers : massive).push_back(static_cast<uint32_t>(i));
+  }
+}
+
+std::vector<Planet>& TracerGravity::sources(std::vector<Planet>& planets) {
+  if (tracers.empty()) {
+    return planets;
+  }
+
+  massive_planets.clear();
+
+  for (uint32_t slot : massive) {
+    massive_planets.push_back(planets[slot]);
+  }
+
+  return massive_planets;
+}
+
+void TracerGravity::gather(std::vector<Planet>& planets) const {
+  if (tracers.empty()) {
+    return;
+  }
+
+  // Solvers only punch, positions are still the same
+  for (size_t i = 0; i < massive.size(); ++i) {
+    planets[massive[i]].velocity = massive_planets[i].velocity;
+  }
+}
+
+void TracerGravity::apply(std::vector<Planet>& planets) {
+  if (tracers.empty()) {
+    return;
+  }
+
+  size_t count = massive.size();
+
+  x.resize(count);
+  y.resize(count);
+  gm.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    Planet const& planet = planets[massive[i]];
+    Vector2d position = Vector2d(planet.position);
+
+    x[i] = position.x;
+    y[i] = position.y;
+    gm[i] = static_cast<float>(G * planet.mass);
+  }
+
+  double const* __restrict px = x.data();
+  double const* __restrict py = y.data();
+  float const* __restrict m = gm.data();
+
+  parallelFor(tracers.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Planet& tracer = planets[tracers[i]];
+      Vector2d position = Vector2d(tracer.position);
+
+      double tx = position.x, ty = position.y;
+
+      float ax = 0.0f, ay = 0.0f;
+
+      // Difference in double, the rest in float like the other kernels
+      #pragma omp simd reduction(+:ax, ay)
+      for (size_t j = 0; j < count; ++j) {
+        float dx = static_cast<float>(px[j] - tx);
+        float dy = static_cast<float>(py[j] - ty);
+
+        float distance2 = dx * dx + dy * dy;
+
+        // A tracer sitting exactly on a body gets nothing from it instead of infinity
+        bool inside = distance2 == 0.0f;
+
+        float inv_distance = 1.0f / sqrtf(inside ? 1.0f : distance2);
+        float factor = inside ? 0.0f : m[j] * inv_distance * inv_distance * inv_distance;
+
+        ax += dx * factor;
+        ay += dy * factor;
+      }
+
+      tracer.punch(StateVector(ax, ay));
+    }
+  });
+}
+
+#if SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT
+
+void DoubleFloatGravity::apply(std::vector<Planet>& planets) {
+  size_t count = planets.size();
+
+  x_hi.resize(count); x_lo.resize(count);
+  y_hi.resize(count); y_lo.resize(count);
+  gm.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    Planet const& planet = planets[i];
+
+    x_hi[i] = planet.position.x.hi; x_lo[i] = planet.position.x.lo;
+    y_hi[i] = planet.position.y.hi; y_lo[i] = planet.position.y.lo;
+    gm[i] = static_cast<float>(G * planet.mass);
+  }
+
+  float const* __restrict xh = x_hi.data();
+  float const* __restrict xl = x_lo.data();
+  float const* __restrict yh = y_hi.data();
+  float const* __restrict yl = y_lo.data();
+  float const* __restrict m = gm.data();
+
+  for (size_t i = 0; i < count; ++i) {
+    float xhi = xh[i], xlo = xl[i];
+    float yhi = yh[i], ylo = yl[i];
+
+    float ax = 0.0f, ay = 0.0f;
+
+    #pragma omp simd reduction(+:ax, ay)
+    for (size_t j = 0; j < count; ++j) {
+      float dx = (xh[j] - xhi) + (xl[j] - xlo);
+      float dy = (yh[j] - yhi) + (yl[j] - ylo);
+
+      float distance2 = dx * dx + dy * dy;
+
+      // Self interaction has zero distance and is masked out without branching
+      bool self = distance2 == 0.0f;
+
+      float inv_distance = 1.0f / sqrtf(self ? 1.0f : distance2);
+      float factor = self ? 0.0f : m[j] * inv_distance * inv_distance * inv_distance;
+
+      ax += dx * factor;
+      ay += dy * factor;
+    }
+
+    Planet& planet = planets[i];
+    planet.punch(StateVector(ax, ay) * planet.mass);
+  }
+}
+
+#endif
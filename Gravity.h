@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "Planet.h"
+
+#define G ( 6.67430151515e-11 ) // Gravity constant
+
+// Splits planets into massive bodies and tracers. Tracers only need the pull of the
+// massive bodies, n_massive * n_tracer work instead of being part of the full sum.
+// The force solvers only ever see the massive bodies, see sources()
+class TracerGravity {
+public:
+  std::vector<uint32_t> massive; // slots in planets
+  std::vector<uint32_t> tracers;
+
+  std::vector<Planet> massive_planets; // compact copy handed to the solvers while there are tracers
+
+  std::vector<double> x, y; // massive bodies
+  std::vector<float> gm;    // G * mass
+
+public:
+  void split(std::vector<Planet> const& planets);
+
+  // Planets for the force solvers, split() must be current: planets itself when there are no
+  // tracers, otherwise a compact copy of the massive ones
+  std::vector<Planet>& sources(std::vector<Planet>& planets);
+
+  // Hands the punches the solvers gave to sources() back to planets
+  void gather(std::vector<Planet>& planets) const;
+
+  // Punches every tracer with its acceleration, split() must be current
+  void apply(std::vector<Planet>& planets);
+};
+
+#if SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT
+
+// Full n*n force sum over a structure-of-arrays copy of the planets.
+// Positions enter the kernel only as float differences of the hi/lo pairs,
+// so the inner loop is plain float arithmetic the compiler can vectorise.
+class DoubleFloatGravity {
+public:
+  std::vector<float> x_hi, x_lo;
+  std::vector<float> y_hi, y_lo;
+  std::vector<float> gm; // G * mass
+
+public:
+  void apply(std::vector<Planet>& planets);
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "Hermite.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+#include "Parallel.h"
+
+// Bodies closer than this many ticks per step are stuck, not accurate
+#define HERMITE_MIN_STEP ( 1.0 / 1099511627776.0 ) // 2^-40
+
+// Largest power of two step not above wanted
+static double quantizeStep(double wanted) {
+  double step = 1.0;
+
+  while (step > wanted && step > HERMITE_MIN_STEP) {
+    step /= 2;
+  }
+
+  return step;
+}
+
+void HermiteIntegrator::step(std::vector<Planet>& planets) {
+  size_t count = planets.size();
+
+  if (count != bodies.size()) {
+    valid = false;
+  }
+
+  bodies.resize(count);
+  predicted_positions.resize(count);
+  predicted_velocities.resize(count);
+  new_accelerations.resize(count);
+  new_jerks.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    Planet const& planet = planets[i];
+    Body& body = bodies[i];
+
+    body.position = Vector2d(planet.position);
+    body.velocity = planet.isTracer() ? Vector2d(planet.velocity) : Vector2d(planet.velocity) / double(planet.mass);
+    body.mass = planet.mass;
+    body.time = 0.0;
+  }
+
+  if (!valid) {
+    active.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+      predicted_positions[i] = bodies[i].position;
+      predicted_velocities[i] = bodies[i].velocity;
+      active.push_back(static_cast<uint32_t>(i));
+    }
+
+    evaluate();
+
+    for (size_t i = 0; i < count; ++i) {
+      Body& body = bodies[i];
+
+      body.acceleration = new_accelerations[i];
+      body.jerk = new_jerks[i];
+
+      double jerk = body.jerk.length();
+      body.step = jerk > 0.0 ? quantizeStep(eta_start * body.acceleration.length() / jerk) : 1.0;
+    }
+
+    valid = true;
+  }
+
+  double time = 0.0;
+
+  while (time < 1.0) {
+    double next = 1.0;
+
+    for (Body const& body : bodies) {
+      next = fmin(next, body.time + body.step);
+    }
+
+    active.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+      if (bodies[i].time + bodies[i].step == next) {
+        active.push_back(static_cast<uint32_t>(i));
+      }
+    }
+
+    predict(next);
+    evaluate();
+    correct(next);
+
+    time = next;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    Planet& planet = planets[i];
+    Body const& body = bodies[i];
+
+    planet.position = PositionVector(body.position);
+    planet.velocity = StateVector(planet.isTracer() ? body.velocity : body.velocity * body.mass);
+  }
+}
+
+void HermiteIntegrator::reorder(std::vector<uint32_t> const& permutation) {
+  if (!valid || permutation.size() != bodies.size()) {
+    valid = false;
+    return;
+  }
+
+  body_scratch = bodies;
+
+  for (size_t slot = 0; slot < bodies.size(); ++slot) {
+    bodies[slot] = body_scratch[permutation[slot]];
+  }
+}
+
+void HermiteIntegrator::invalidate() {
+  valid = false;
+}
+
+void HermiteIntegrator::predict(double time) {
+  parallelFor(bodies.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Body const& body = bodies[i];
+      double dt = time - body.time;
+
+      predicted_positions[i] =
+        body.position + body.velocity * dt + body.acceleration * (dt * dt / 2) + body.jerk * (dt * dt * dt / 6);
+      predicted_velocities[i] =
+        body.velocity + body.acceleration * dt + body.jerk * (dt * dt / 2);
+    }
+  });
+}
+
+// Acceleration and jerk of the active bodies from the predicted state of all of them
+void HermiteIntegrator::evaluate() {
+  size_t count = bodies.size();
+
+  parallelFor(active.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      uint32_t i = active[k];
+
+      Vector2d position = predicted_positions[i];
+      Vector2d velocity = predicted_velocities[i];
+
+      Vector2d acceleration;
+      Vector2d jerk;
+
+      for (size_t j = 0; j < count; ++j) {
+        if (j == i || bodies[j].mass == 0.0) {
+          continue;
+        }
+
+        Vector2d dx = predicted_positions[j] - position;
+        Vector2d dv = predicted_velocities[j] - velocity;
+
+        double inv_r2 = 1.0 / (dx.x * dx.x + dx.y * dx.y);
+        double gm_inv_r3 = G * bodies[j].mass * inv_r2 * sqrt(inv_r2);
+
+        double rv = 3.0 * (dx.x * dv.x + dx.y * dv.y) * inv_r2;
+
+        acceleration += dx * gm_inv_r3;
+        jerk += (dv - dx * rv) * gm_inv_r3;
+      }
+
+      new_accelerations[i] = acceleration;
+      new_jerks[i] = jerk;
+    }
+  });
+}
+
+void HermiteIntegrator::correct(double time) {
+  parallelFor(active.size(), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      uint32_t i = active[k];
+      Body& body = bodies[i];
+
+      double dt = time - body.time;
+
+      Vector2d a0 = body.acceleration, j0 = body.jerk;
+      Vector2d a1 = new_accelerations[i], j1 = new_jerks[i];
+
+      Vector2d velocity = body.velocity + (a0 + a1) * (dt / 2) + (j0 - j1) * (dt * dt / 12);
+      Vector2d position = body.position + (body.velocity + velocity) * (dt / 2) + (a0 - a1) * (dt * dt / 12);
+
+      // Snap and crackle at the end of the step from the Hermite interpolant
+      Vector2d snap = ((a1 - a0) * 6.0 - (j0 * 4.0 + j1 * 2.0) * dt) / (dt * dt);
+      Vector2d crackle = ((a0 - a1) * 12.0 + (j0 + j1) * (6.0 * dt)) / (dt * dt * dt);
+
+      snap += crackle * dt;
+
+      body.position = position;
+      body.velocity = velocity;
+      body.acceleration = a1;
+      body.jerk = j1;
+      body.time = time;
+
+      // Aarseth criterion
+      double a = a1.length(), j = j1.length(), s = snap.length(), c = crackle.length();
+      double denominator = j * c + s * s;
+
+      double wanted = denominator > 0.0 ? sqrt(eta * (a * s + j * j) / denominator) : 1.0;
+
+      // Halving is always allowed, doubling only when the new step stays on the block grid
+      double step = body.step;
+
+      while (step > wanted && step > HERMITE_MIN_STEP) {
+        step /= 2;
+      }
+
+      if (step == body.step && wanted >= step * 2 && step < 1.0 && fmod(time, step * 2) == 0.0) {
+        step *= 2;
+      }
+
+      body.step = step;
+    }
+  });
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Planet.h"
+
+// Fourth order Hermite predictor-corrector (Makino & Aarseth 1992) with block time steps.
+// Every body gets its own power of two fraction of a tick picked by the Aarseth criterion,
+// and only bodies due at a block time get their force and jerk evaluated. All bodies meet
+// again at the end of each tick
+class HermiteIntegrator {
+public:
+  struct Body {
+    Vector2d position;
+    Vector2d velocity; // plain velocity, not momentum
+    Vector2d acceleration;
+    Vector2d jerk;
+    double   mass;
+    double   time; // within the current tick
+    double   step;
+  };
+
+  std::vector<Body> bodies;
+  std::vector<Body> body_scratch;
+
+  std::vector<Vector2d> predicted_positions;
+  std::vector<Vector2d> predicted_velocities;
+
+  std::vector<uint32_t> active;
+  std::vector<Vector2d> new_accelerations;
+  std::vector<Vector2d> new_jerks;
+
+  double eta = 0.02;        // Aarseth accuracy parameter
+  double eta_start = 0.01;  // first steps only know acceleration and jerk
+
+  bool valid = false;
+
+public:
+  // Advances planets by one tick, forces included
+  void step(std::vector<Planet>& planets);
+
+  // Moves the accelerations and steps carried over from the last tick along with their planets,
+  // permutation[slot] is the slot the planet had before (MortonOrder::permutation)
+  void reorder(std::vector<uint32_t> const& permutation);
+
+  // Forgets them, the next tick starts the block steps over
+  void invalidate();
+
+private:
+  void predict(double time);
+  void evaluate();
+  void correct(double time);
+};
@@ -0,0 +1,185 @@
+#include "Morton.h"
+
+#include <math.h>
+
+#include "Parallel.h"
+
+#define RADIX_BITS ( 8 )
+#define RADIX_BUCKETS ( 1 << RADIX_BITS )
+
+// Below this many keys per block the histograms cost more than they save
+#define RADIX_MIN_BLOCK ( 4096 )
+
+// Kept between sorts, so sorting the same number of keys again doesn't allocate
+static thread_local std::vector<size_t> radix_offsets;
+static thread_local std::vector<uint64_t> radix_differences;
+
+void radixSort(
+  std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+  std::vector<uint64_t>& key_scratch, std::vector<uint32_t>& value_scratch
+) {
+  size_t count = keys.size();
+
+  if (count < 2) {
+    return;
+  }
+
+  key_scratch.resize(count);
+  value_scratch.resize(count);
+
+  // Each block is sorted into its own range of every bucket, which keeps the sort stable
+  size_t blocks = (count + RADIX_MIN_BLOCK - 1) / RADIX_MIN_BLOCK;
+
+  if (blocks > threadCount()) {
+    blocks = threadCount();
+  }
+
+  size_t block_size = (count + blocks - 1) / blocks;
+
+  // Lambdas don't capture thread_locals, the workers would see their own, so go through references
+  std::vector<size_t>& offsets = radix_offsets;
+  offsets.resize(blocks * RADIX_BUCKETS);
+
+  // Bits that differ anywhere, digits without any are already sorted
+  std::vector<uint64_t>& block_differences = radix_differences;
+  block_differences.assign(blocks, 0);
+
+  parallelFor(blocks, [&](size_t begin, size_t end) {
+    for (size_t block = begin; block < end; ++block) {
+      size_t first = block * block_size;
+      size_t last = first + block_size < count ? first + block_size : count;
+
+      uint64_t differences = 0;
+
+      for (size_t i = first; i < last; ++i) {
+        differences |= keys[i] ^ keys[0];
+      }
+
+      block_differences[block] = differences;
+    }
+  });
+
+  uint64_t differences = 0;
+
+  for (uint64_t block_difference : block_differences) {
+    differences |= block_difference;
+  }
+
+  for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+    if (((differences >> shift) & (RADIX_BUCKETS - 1)) == 0) {
+      continue;
+    }
+
+    parallelFor(blocks, [&](size_t begin, size_t end) {
+      for (size_t block = begin; block < end; ++block) {
+        size_t first = block * block_size;
+        size_t last = first + block_size < count ? first + block_size : count;
+
+        size_t* histogram = &offsets[block * RADIX_BUCKETS];
+
+        for (size_t digit = 0; digit < RADIX_BUCKETS; ++digit) {
+          histogram[digit] = 0;
+        }
+
+        for (size_t i = first; i < last; ++i) {
+          ++histogram[(keys[i] >> shift) & (RADIX_BUCKETS - 1)];
+        }
+      }
+    });
+
+    // Bucket by bucket, block by block
+    size_t position = 0;
+
+    for (size_t digit = 0; digit < RADIX_BUCKETS; ++digit) {
+      for (size_t block = 0; block < blocks; ++block) {
+        size_t bucket_count = offsets[block * RADIX_BUCKETS + digit];
+
+        offsets[block * RADIX_BUCKETS + digit] = position;
+        position += bucket_count;
+      }
+    }
+
+    parallelFor(blocks, [&](size_t begin, size_t end) {
+      for (size_t block = begin; block < end; ++block) {
+        size_t first = block * block_size;
+        size_t last = first + block_size < count ? first + block_size : count;
+
+        size_t* offset = &offsets[block * RADIX_BUCKETS];
+
+        for (size_t i = first; i < last; ++i) {
+          size_t target = offset[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+
+          key_scratch[target] = keys[i];
+          value_scratch[target] = values[i];
+        }
+      }
+    });
+
+    keys.swap(key_scratch);
+    values.swap(value_scratch);
+  }
+}
+
+void MortonOrder::track(size_t count) {
+  while (ids.size() < count) {
+    uint32_t id = static_cast<uint32_t>(ids.size());
+
+    ids.push_back(id);
+    slots.push_back(id);
+  }
+}
+
+void MortonOrder::reorder(std::vector<Planet>& planets) {
+  size_t count = planets.size();
+
+  track(count);
+
+  if (count < 2) {
+    return;
+  }
+
+  Vector2d min = Vector2d(planets[0].position);
+  Vector2d max = min;
+
+  for (Planet const& planet : planets) {
+    Vector2d position = Vector2d(planet.position);
+
+    min.x = fmin(min.x, position.x); min.y = fmin(min.y, position.y);
+    max.x = fmax(max.x, position.x); max.y = fmax(max.y, position.y);
+  }
+
+  double extent = fmax(max.x - min.x, max.y - min.y);
+
+  // Grid cells per pixel, the far edge of the box still maps into 32 bits
+  double scale = extent > 0.0 ? 4294967040.0 / extent : 0.0;
+
+  keys.resize(count);
+  permutation.resize(count);
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Vector2d position = Vector2d(planets[i].position);
+
+      uint32_t x = static_cast<uint32_t>((position.x - min.x) * scale);
+      uint32_t y = static_cast<uint32_t>((position.y - min.y) * scale);
+
+      keys[i] = mortonKey(x, y);
+      permutation[i] = static_cast<uint32_t>(i);
+    }
+  });
+
+  radixSort(keys, permutation, key_scratch, permutation_scratch);
+
+  planet_scratch = planets;
+  id_scratch = ids;
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t slot = begin; slot < end; ++slot) {
+      uint32_t previous = permutation[slot];
+
+      planets[slot] = planet_scratch[previous];
+      ids[slot] = id_scratch[previous];
+      slots[ids[slot]] = static_cast<uint32_t>(slot);
+    }
+  });
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Planet.h"
+
+// Moves the bits of value to the even bit positions
+inline uint64_t spreadBits(uint32_t value) {
+  uint64_t x = value;
+
+  x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+  x = (x | (x << 8))  & 0x00FF00FF00FF00FFull;
+  x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0Full;
+  x = (x | (x << 2))  & 0x3333333333333333ull;
+  x = (x | (x << 1))  & 0x5555555555555555ull;
+
+  return x;
+}
+
+// Position along the Z-order curve of a cell on a 2^32 x 2^32 grid
+inline uint64_t mortonKey(uint32_t x, uint32_t y) {
+  return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// Stable parallel LSD radix sort, 8 bits per pass, values move with their keys.
+// Passes over digits that all keys share are skipped. Scratch is resized as needed
+void radixSort(
+  std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+  std::vector<uint64_t>& key_scratch, std::vector<uint32_t>& value_scratch
+);
+
+// Keeps planets sorted along a Z-order curve, so bodies close in space are close in memory.
+// Reordering moves planets between slots, ids stay with the planet they were handed out to
+class MortonOrder {
+public:
+  std::vector<uint32_t> ids;   // ids[slot], id of the planet in that slot
+  std::vector<uint32_t> slots; // slots[id], slot that planet is in now
+
+  std::vector<uint64_t> keys, key_scratch;
+  std::vector<uint32_t> permutation, permutation_scratch; // permutation[slot], slot before the last reorder
+  std::vector<uint32_t> id_scratch;
+  std::vector<Planet> planet_scratch;
+
+public:
+  // Hands out ids to planets appended since the last call, in slot order
+  void track(size_t count);
+
+  // Sorts planets by the Morton key of their position inside the bounding box
+  void reorder(std::vector<Planet>& planets);
+
+  Planet& planet(std::vector<Planet>& planets, uint32_t id) const {
+    return planets[slots[id]];
+  }
+};
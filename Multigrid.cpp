@@ -0,0 +1,378 @@
+#include "Multigrid.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "Gravity.h"
+#include "Parallel.h"
+
+static constexpr double FOUR_PI = 12.566370614359172;
+
+// Exact solve of the coarsest level, it has only a few dozen unknowns
+#define COARSEST_SWEEPS ( 64 )
+
+MultigridGravity::MultigridGravity(size_t grid_size) {
+  for (size_t n = grid_size; n >= 4; n /= 2) {
+    Level level;
+    level.n = n;
+    level.nz = n / 2;
+    level.h = 0.0;
+
+    size_t nodes = (n + 1) * (n + 1) * (n / 2 + 1);
+
+    level.potential.assign(nodes, 0.0);
+    level.source.assign(nodes, 0.0);
+    level.residual.assign(nodes, 0.0);
+
+    levels.push_back(std::move(level));
+  }
+
+  field.resize((grid_size + 1) * (grid_size + 1));
+}
+
+void MultigridGravity::apply(std::vector<Planet>& planets) {
+  if (planets.empty()) {
+    return;
+  }
+
+  if (fitDomain(planets)) {
+    levels[0].potential.assign(levels[0].potential.size(), 0.0);
+  }
+
+  assignMass(planets);
+  setBoundary(planets);
+  solve();
+  computeField();
+
+  Level const& fine = levels[0];
+  size_t n = fine.n;
+
+  parallelFor(planets.size(), [&](size_t begin, size_t end) {
+    for (size_t body = begin; body < end; ++body) {
+      Planet& planet = planets[body];
+      Vector2d position = Vector2d(planet.position);
+
+      double u = (position.x - corner.x) / fine.h;
+      double v = (position.y - corner.y) / fine.h;
+
+      size_t i = static_cast<size_t>(u);
+      size_t j = static_cast<size_t>(v);
+
+      double fx = u - i;
+      double fy = v - j;
+
+      Vector2d acceleration =
+        field[j * (n + 1) + i]           * ((1 - fx) * (1 - fy)) +
+        field[j * (n + 1) + i + 1]       * (fx * (1 - fy)) +
+        field[(j + 1) * (n + 1) + i]     * ((1 - fx) * fy) +
+        field[(j + 1) * (n + 1) + i + 1] * (fx * fy);
+
+      planet.punch(StateVector(acceleration * double(planet.mass)));
+    }
+  });
+}
+
+bool MultigridGravity::fitDomain(std::vector<Planet> const& planets) {
+  Vector2d min = Vector2d(planets[0].position);
+  Vector2d max = min;
+
+  for (Planet const& planet : planets) {
+    Vector2d position = Vector2d(planet.position);
+
+    min.x = fmin(min.x, position.x); min.y = fmin(min.y, position.y);
+    max.x = fmax(max.x, position.x); max.y = fmax(max.y, position.y);
+  }
+
+  double extent = fmax(fmax(max.x - min.x, max.y - min.y), 1.0);
+
+  if (domain_size > 0.0) {
+    // Keep the domain while bodies stay clear of the boundary cells and it isn't far too big
+    double margin = domain_size / 8;
+
+    bool inside =
+      min.x >= corner.x + margin && max.x <= corner.x + domain_size - margin &&
+      min.y >= corner.y + margin && max.y <= corner.y + domain_size - margin;
+
+    if (inside && extent * padding * 2 >= domain_size) {
+      return false;
+    }
+  }
+
+  domain_size = extent * padding;
+  corner = (min + max) / 2 - Vector2d(domain_size / 2);
+
+  for (Level& level : levels) {
+    level.h = domain_size / level.n;
+  }
+
+  return true;
+}
+
+void MultigridGravity::assignMass(std::vector<Planet> const& planets) {
+  Level& fine = levels[0];
+
+  fine.source.assign(fine.source.size(), 0.0);
+
+  // Sheet density over one node layer, so the plane's row of the mirrored Laplacian
+  // reproduces the 2 pi G sigma jump of dphi/dz
+  double factor = FOUR_PI * G / (fine.h * fine.h * fine.h);
+
+  // Bilinear weights, serial: a parallel version would need one plane per thread
+  // and this is cheap next to the V-cycles
+  for (Planet const& planet : planets) {
+    Vector2d position = Vector2d(planet.position);
+
+    double u = (position.x - corner.x) / fine.h;
+    double v = (position.y - corner.y) / fine.h;
+
+    size_t i = static_cast<size_t>(u);
+    size_t j = static_cast<size_t>(v);
+
+    double fx = u - i;
+    double fy = v - j;
+
+    double source = factor * planet.mass;
+
+    fine.source[fine.index(i,     j,     0)] += source * (1 - fx) * (1 - fy);
+    fine.source[fine.index(i + 1, j,     0)] += source * fx * (1 - fy);
+    fine.source[fine.index(i,     j + 1, 0)] += source * (1 - fx) * fy;
+    fine.source[fine.index(i + 1, j + 1, 0)] += source * fx * fy;
+  }
+}
+
+void MultigridGravity::setBoundary(std::vector<Planet> const& planets) {
+  double mass = 0.0;
+  Vector2d weighted;
+
+  for (Planet const& planet : planets) {
+    mass += planet.mass;
+    weighted += Vector2d(planet.position) * double(planet.mass);
+  }
+
+  Vector2d center = weighted / mass;
+
+  // Traceless quadrupole about the centre of mass, bodies have z = 0
+  double qxx = 0.0, qyy = 0.0, qxy = 0.0, qzz = 0.0;
+
+  for (Planet const& planet : planets) {
+    Vector2d r = Vector2d(planet.position) - center;
+    double r2 = r.x * r.x + r.y * r.y;
+
+    qxx += planet.mass * (3 * r.x * r.x - r2);
+    qyy += planet.mass * (3 * r.y * r.y - r2);
+    qxy += planet.mass * (3 * r.x * r.y);
+    qzz -= planet.mass * r2;
+  }
+
+  Level& fine = levels[0];
+  size_t n = fine.n;
+
+  auto expansion = [&](size_t i, size_t j, size_t k) {
+    double x = corner.x + i * fine.h - center.x;
+    double y = corner.y + j * fine.h - center.y;
+    double z = k * fine.h;
+
+    double r2 = x * x + y * y + z * z;
+    double r = sqrt(r2);
+
+    double quadrupole = qxx * x * x + qyy * y * y + qzz * z * z + 2 * qxy * x * y;
+
+    return -G * (mass / r + 0.5 * quadrupole / (r2 * r2 * r));
+  };
+
+  parallelFor(fine.nz + 1, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      bool top = k == fine.nz;
+
+      for (size_t j = 0; j <= n; ++j) {
+        for (size_t i = 0; i <= n; ++i) {
+          if (top || i == 0 || j == 0 || i == n || j == n) {
+            fine.potential[fine.index(i, j, k)] = expansion(i, j, k);
+          }
+        }
+      }
+    }
+  });
+}
+
+void MultigridGravity::solve() {
+  Level& fine = levels[0];
+
+  double source_norm = 0.0;
+  for (double value : fine.source) {
+    source_norm += value * value;
+  }
+  source_norm = sqrt(source_norm);
+
+  for (uint32_t cycle = 0; cycle < max_cycles; ++cycle) {
+    computeResidual(fine);
+
+    if (residualNorm(fine) <= tolerance * source_norm) {
+      break;
+    }
+
+    vCycle(0);
+  }
+}
+
+void MultigridGravity::vCycle(size_t index) {
+  Level& level = levels[index];
+
+  if (index + 1 == levels.size()) {
+    smooth(level, COARSEST_SWEEPS);
+    return;
+  }
+
+  Level& coarse = levels[index + 1];
+
+  smooth(level, smoothing_sweeps);
+  computeResidual(level);
+
+  restrictResidual(level, coarse);
+  coarse.potential.assign(coarse.potential.size(), 0.0);
+
+  vCycle(index + 1);
+
+  prolongateCorrection(coarse, level);
+  smooth(level, smoothing_sweeps);
+}
+
+void MultigridGravity::smooth(Level& level, uint32_t sweeps) {
+  size_t n = level.n;
+  size_t row = n + 1;
+  size_t layer = row * row;
+  double h2 = level.h * level.h;
+
+  for (uint32_t sweep = 0; sweep < sweeps; ++sweep) {
+    // Red-black ordering, nodes of one colour only depend on the other one
+    for (size_t color = 0; color < 2; ++color) {
+      parallelFor(level.nz, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+          for (size_t j = 1; j < n; ++j) {
+            size_t i = 1 + ((1 + j + k + color) & 1);
+
+            for (; i < n; i += 2) {
+              size_t at = level.index(i, j, k);
+              double* p = level.potential.data();
+
+              // z = 0 is the mirror plane, the node below equals the one above
+              double below = k > 0 ? p[at - layer] : p[at + layer];
+
+              double neighbours =
+                p[at - 1] + p[at + 1] +
+                p[at - row] + p[at + row] +
+                below + p[at + layer];
+
+              p[at] = (neighbours - h2 * level.source[at]) / 6;
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+void MultigridGravity::computeResidual(Level& level) {
+  size_t n = level.n;
+  size_t row = n + 1;
+  size_t layer = row * row;
+  double inv_h2 = 1.0 / (level.h * level.h);
+
+  parallelFor(level.nz, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      for (size_t j = 1; j < n; ++j) {
+        for (size_t i = 1; i < n; ++i) {
+          size_t at = level.index(i, j, k);
+          double const* p = level.potential.data();
+
+          double below = k > 0 ? p[at - layer] : p[at + layer];
+
+          double laplacian =
+            (p[at - 1] + p[at + 1] + p[at - row] + p[at + row] + below + p[at + layer] - 6 * p[at]) * inv_h2;
+
+          level.residual[at] = level.source[at] - laplacian;
+        }
+      }
+    }
+  });
+}
+
+double MultigridGravity::residualNorm(Level const& level) const {
+  double sum = 0.0;
+
+  for (double value : level.residual) {
+    sum += value * value;
+  }
+
+  return sqrt(sum);
+}
+
+void MultigridGravity::restrictResidual(Level const& fine, Level& coarse) {
+  coarse.source.assign(coarse.source.size(), 0.0);
+
+  // Full weighting, (2 - |d|) / 4 per axis
+  parallelFor(coarse.nz, [&](size_t begin, size_t end) {
+    for (size_t kc = begin; kc < end; ++kc) {
+      for (size_t jc = 1; jc < coarse.n; ++jc) {
+        for (size_t ic = 1; ic < coarse.n; ++ic) {
+          double sum = 0.0;
+
+          for (int dk = -1; dk <= 1; ++dk) {
+            // Mirror below the plane
+            long k = long(kc * 2) + dk;
+            size_t kf = static_cast<size_t>(k < 0 ? -k : k);
+
+            for (int dj = -1; dj <= 1; ++dj) {
+              for (int di = -1; di <= 1; ++di) {
+                double weight = (2 - abs(di)) * (2 - abs(dj)) * (2 - abs(dk)) / 64.0;
+                sum += weight * fine.residual[fine.index(ic * 2 + di, jc * 2 + dj, kf)];
+              }
+            }
+          }
+
+          coarse.source[coarse.index(ic, jc, kc)] = sum;
+        }
+      }
+    }
+  });
+}
+
+void MultigridGravity::prolongateCorrection(Level const& coarse, Level& fine) {
+  parallelFor(fine.nz, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      for (size_t j = 1; j < fine.n; ++j) {
+        for (size_t i = 1; i < fine.n; ++i) {
+          // Trilinear, odd fine indices sit halfway between two coarse nodes
+          size_t i0 = i / 2, i1 = (i + 1) / 2;
+          size_t j0 = j / 2, j1 = (j + 1) / 2;
+          size_t k0 = k / 2, k1 = (k + 1) / 2;
+
+          double correction = 0.125 * (
+            coarse.potential[coarse.index(i0, j0, k0)] + coarse.potential[coarse.index(i1, j0, k0)] +
+            coarse.potential[coarse.index(i0, j1, k0)] + coarse.potential[coarse.index(i1, j1, k0)] +
+            coarse.potential[coarse.index(i0, j0, k1)] + coarse.potential[coarse.index(i1, j0, k1)] +
+            coarse.potential[coarse.index(i0, j1, k1)] + coarse.potential[coarse.index(i1, j1, k1)]
+          );
+
+          fine.potential[fine.index(i, j, k)] += correction;
+        }
+      }
+    }
+  });
+}
+
+void MultigridGravity::computeField() {
+  Level const& fine = levels[0];
+  size_t n = fine.n;
+
+  parallelFor(n - 1, [&](size_t begin, size_t end) {
+    for (size_t j = begin + 1; j < end + 1; ++j) {
+      for (size_t i = 1; i < n; ++i) {
+        double dx = fine.potential[fine.index(i + 1, j, 0)] - fine.potential[fine.index(i - 1, j, 0)];
+        double dy = fine.potential[fine.index(i, j + 1, 0)] - fine.potential[fine.index(i, j - 1, 0)];
+
+        field[j * (n + 1) + i] = Vector2d(dx, dy) / (-2 * fine.h);
+      }
+    }
+  });
+}
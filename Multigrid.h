@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "Planet.h"
+
+// Geometric multigrid gravity for open (isolated) space.
+//
+// applyGravity's 1 / r^2 force is the in-plane field of a mass sheet in three dimensions,
+// so the potential solves the 3D Poisson equation with the surface density as a source on
+// z = 0. The solver keeps only z >= 0 (the other half is its mirror image) on a vertex
+// centred grid: grid_size intervals across the plane, grid_size / 2 above it. The outer
+// faces get Dirichlet values from the monopole + quadrupole expansion of the bodies.
+// V-cycles use red-black Gauss-Seidel, full weighting and trilinear prolongation, and
+// start from the previous tick's potential while the domain doesn't move.
+class MultigridGravity {
+public:
+  struct Level {
+    size_t n;  // intervals across the plane, nodes 0..n in x and y
+    size_t nz; // intervals above the plane, nodes 0..nz
+    double h;
+
+    std::vector<double> potential;
+    std::vector<double> source;
+    std::vector<double> residual;
+
+    inline size_t index(size_t i, size_t j, size_t k) const noexcept {
+      return (k * (n + 1) + j) * (n + 1) + i;
+    }
+  };
+
+  std::vector<Level> levels; // levels[0] is the finest
+
+  Vector2d corner;       // position of node (0, 0, 0)
+  double domain_size = 0.0;
+
+  double   padding = 3.0;      // domain side over the bodies' extent
+  uint32_t smoothing_sweeps = 2;
+  uint32_t max_cycles = 10;
+  double   tolerance = 1e-5;   // residual norm relative to the source norm
+
+  std::vector<Vector2d> field; // acceleration on the plane nodes
+
+public:
+  MultigridGravity(size_t grid_size = 128);
+
+public:
+  void apply(std::vector<Planet>& planets);
+
+  // Returns true if the domain was moved, the previous potential is useless then
+  bool fitDomain(std::vector<Planet> const& planets);
+
+  void assignMass(std::vector<Planet> const& planets);
+  void setBoundary(std::vector<Planet> const& planets);
+  void solve();
+  void computeField();
+
+  void vCycle(size_t level);
+  void smooth(Level& level, uint32_t sweeps);
+  void computeResidual(Level& level);
+  double residualNorm(Level const& level) const;
+  void restrictResidual(Level const& fine, Level& coarse);
+  void prolongateCorrection(Level const& coarse, Level& fine);
+};
@@ -0,0 +1,197 @@
+#include "Multipole.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+
+// Enough for any order the solvers use, powers and derivatives live on the stack
+#define MAX_EXPANSION_ORDER ( 16 )
+
+Expansion::Expansion(uint32_t order) {
+  if (order > MAX_EXPANSION_ORDER - 1) {
+    order = MAX_EXPANSION_ORDER - 1;
+  }
+
+  this->order = order;
+  this->terms = termCount(order);
+
+  power_x.resize(terms);
+  power_y.resize(terms);
+  inverse_factorial.resize(terms);
+
+  double factorial[MAX_EXPANSION_ORDER + 1];
+  factorial[0] = 1.0;
+  for (uint32_t i = 1; i <= MAX_EXPANSION_ORDER; ++i) {
+    factorial[i] = factorial[i - 1] * i;
+  }
+
+  for (uint32_t n = 0; n <= order; ++n) {
+    for (uint32_t b = 0; b <= n; ++b) {
+      uint32_t a = n - b;
+      uint32_t at = index(a, b);
+
+      power_x[at] = a;
+      power_y[at] = b;
+      inverse_factorial[at] = 1.0 / (factorial[a] * factorial[b]);
+    }
+  }
+
+  derivative_weights.assign((MAX_EXPANSION_ORDER + 1) * (MAX_EXPANSION_ORDER + 1), 0.0);
+  for (uint32_t a = 0; a <= MAX_EXPANSION_ORDER; ++a) {
+    for (uint32_t i = 0; 2 * i <= a; ++i) {
+      derivative_weights[a * (MAX_EXPANSION_ORDER + 1) + i] = factorial[a] / (factorial[i] * factorial[a - 2 * i]);
+    }
+  }
+}
+
+void Expansion::powers(Vector2d v, uint32_t max_power, double* x, double* y) const {
+  x[0] = 1.0;
+  y[0] = 1.0;
+
+  for (uint32_t i = 1; i <= max_power; ++i) {
+    x[i] = x[i - 1] * v.x;
+    y[i] = y[i - 1] * v.y;
+  }
+}
+
+void Expansion::derivatives(Vector2d r, uint32_t max_order, double* out) const {
+  // 1 / |r| = F(s), s = x^2 + y^2, and
+  //   d^a/dx^a d^b/dy^b F = sum_ij a!/(i!(a-2i)!) b!/(j!(b-2j)!) (2x)^(a-2i) (2y)^(b-2j) F^(a+b-i-j)(s)
+  // with F^(n)(s) = (-1/2)(-3/2)..(-(2n-1)/2) s^(-1/2-n)
+  double s = r.x * r.x + r.y * r.y;
+
+  double f[MAX_EXPANSION_ORDER + 1];
+  f[0] = 1.0 / sqrt(s);
+  for (uint32_t n = 1; n <= max_order; ++n) {
+    f[n] = f[n - 1] * -(2.0 * n - 1.0) / (2.0 * s);
+  }
+
+  double px[MAX_EXPANSION_ORDER + 1], py[MAX_EXPANSION_ORDER + 1];
+  powers(Vector2d(2 * r.x, 2 * r.y), max_order, px, py);
+
+  uint32_t stride = MAX_EXPANSION_ORDER + 1;
+
+  for (uint32_t n = 0; n <= max_order; ++n) {
+    for (uint32_t b = 0; b <= n; ++b) {
+      uint32_t a = n - b;
+      double sum = 0.0;
+
+      for (uint32_t i = 0; 2 * i <= a; ++i) {
+        double wx = derivative_weights[a * stride + i] * px[a - 2 * i];
+
+        for (uint32_t j = 0; 2 * j <= b; ++j) {
+          sum += wx * derivative_weights[b * stride + j] * py[b - 2 * j] * f[n - i - j];
+        }
+      }
+
+      out[index(a, b)] = sum;
+    }
+  }
+}
+
+void Expansion::addParticle(Vector2d offset, double mass, double* multipole) const {
+  double px[MAX_EXPANSION_ORDER + 1], py[MAX_EXPANSION_ORDER + 1];
+  powers(offset, order, px, py);
+
+  for (uint32_t at = 0; at < terms; ++at) {
+    multipole[at] += mass * px[power_x[at]] * py[power_y[at]] * inverse_factorial[at];
+  }
+}
+
+void Expansion::shiftMultipole(double const* child, Vector2d shift, double* parent) const {
+  double px[MAX_EXPANSION_ORDER + 1], py[MAX_EXPANSION_ORDER + 1];
+  powers(shift, order, px, py);
+
+  // M_parent(a, b) += sum over (i, j) <= (a, b) of M_child(i, j) t^(a-i, b-j) / (a-i)! (b-j)!
+  for (uint32_t at = 0; at < terms; ++at) {
+    uint32_t a = power_x[at], b = power_y[at];
+    double sum = 0.0;
+
+    for (uint32_t i = 0; i <= a; ++i) {
+      for (uint32_t j = 0; j <= b; ++j) {
+        uint32_t rest = index(a - i, b - j);
+        sum += child[index(i, j)] * px[a - i] * py[b - j] * inverse_factorial[rest];
+      }
+    }
+
+    parent[at] += sum;
+  }
+}
+
+void Expansion::multipoleToLocal(double const* multipole, Vector2d separation, double* local) const {
+  double d[termCount(MAX_EXPANSION_ORDER)];
+  derivatives(separation, order, d);
+
+  // L(a, b) = -G sum (-1)^(i+j) M(i, j) D(a+i, b+j), a + b + i + j <= order
+  for (uint32_t at = 0; at < terms; ++at) {
+    uint32_t a = power_x[at], b = power_y[at];
+    uint32_t remaining = order - a - b;
+    double sum = 0.0;
+
+    for (uint32_t n = 0; n <= remaining; ++n) {
+      double sign = (n & 1) ? -1.0 : 1.0;
+
+      for (uint32_t j = 0; j <= n; ++j) {
+        uint32_t i = n - j;
+        sum += sign * multipole[index(i, j)] * d[index(a + i, b + j)];
+      }
+    }
+
+    local[at] += -G * sum;
+  }
+}
+
+void Expansion::shiftLocal(double const* parent, Vector2d shift, double* child) const {
+  double px[MAX_EXPANSION_ORDER + 1], py[MAX_EXPANSION_ORDER + 1];
+  powers(shift, order, px, py);
+
+  // L_child(a, b) += sum over (i, j) >= (a, b) of L_parent(i, j) t^(i-a, j-b) / (i-a)! (j-b)!
+  for (uint32_t at = 0; at < terms; ++at) {
+    uint32_t a = power_x[at], b = power_y[at];
+    double sum = 0.0;
+
+    for (uint32_t i = a; i <= order; ++i) {
+      for (uint32_t j = b; i + j <= order; ++j) {
+        sum += parent[index(i, j)] * px[i - a] * py[j - b] * inverse_factorial[index(i - a, j - b)];
+      }
+    }
+
+    child[at] += sum;
+  }
+}
+
+Vector2d Expansion::localAcceleration(double const* local, Vector2d offset) const {
+  double px[MAX_EXPANSION_ORDER + 1], py[MAX_EXPANSION_ORDER + 1];
+  powers(offset, order, px, py);
+
+  // Acceleration is minus the gradient of sum L(a, b) u^(a, b) / a! b!
+  Vector2d gradient;
+
+  for (uint32_t at = 0; at < termCount(order - 1); ++at) {
+    uint32_t a = power_x[at], b = power_y[at];
+    double weight = px[a] * py[b] * inverse_factorial[at];
+
+    gradient.x += local[index(a + 1, b)] * weight;
+    gradient.y += local[index(a, b + 1)] * weight;
+  }
+
+  return -gradient;
+}
+
+Vector2d Expansion::multipoleAcceleration(double const* multipole, Vector2d separation) const {
+  double d[termCount(MAX_EXPANSION_ORDER)];
+  derivatives(separation, order + 1, d);
+
+  // Acceleration = G sum (-1)^(a+b) M(a, b) grad D(a, b)
+  Vector2d sum;
+
+  for (uint32_t at = 0; at < terms; ++at) {
+    uint32_t a = power_x[at], b = power_y[at];
+    double weight = ((a + b) & 1) ? -multipole[at] : multipole[at];
+
+    sum.x += weight * d[index(a + 1, b)];
+    sum.y += weight * d[index(a, b + 1)];
+  }
+
+  return sum * G;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Vector.h"
+
+// Cartesian Taylor expansions of the planar 1 / r potential, up to a fixed order.
+//
+// Terms are multi-indices (a, b), a + b <= order, stored at index(a, b). A multipole about c
+// holds M_ab = sum m (x - c_x)^a (y - c_y)^b / (a! b!), a local expansion holds the derivatives
+// L_ab of the potential at its centre. The potential is applyGravity's -G m / r, which is not
+// harmonic in the plane, so the complex-variable expansions of the 2D log kernel don't apply.
+class Expansion {
+public:
+  uint32_t order;
+  uint32_t terms;
+
+  std::vector<uint32_t> power_x, power_y;   // by index
+  std::vector<double> inverse_factorial;    // 1 / (a! b!) by index
+  std::vector<double> derivative_weights;   // a! / (i! (a - 2i)!), see derivatives()
+
+public:
+  Expansion(uint32_t order);
+
+public:
+  static constexpr uint32_t index(uint32_t a, uint32_t b) noexcept {
+    uint32_t n = a + b;
+    return n * (n + 1) / 2 + b;
+  }
+
+  static constexpr uint32_t termCount(uint32_t order) noexcept {
+    return (order + 1) * (order + 2) / 2;
+  }
+
+  // D_ab = d^a/dx^a d^b/dy^b (1 / |r|) for a + b <= max_order, out has termCount(max_order) entries
+  void derivatives(Vector2d r, uint32_t max_order, double* out) const;
+
+  void addParticle(Vector2d offset, double mass, double* multipole) const;
+  void shiftMultipole(double const* child, Vector2d shift, double* parent) const; // shift = child centre - parent centre
+  void multipoleToLocal(double const* multipole, Vector2d separation, double* local) const; // separation = local centre - multipole centre
+  void shiftLocal(double const* parent, Vector2d shift, double* child) const; // shift = child centre - parent centre
+
+  Vector2d localAcceleration(double const* local, Vector2d offset) const;
+  Vector2d multipoleAcceleration(double const* multipole, Vector2d separation) const; // separation = body - multipole centre
+
+private:
+  void powers(Vector2d v, uint32_t max_power, double* x, double* y) const;
+};
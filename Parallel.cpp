@@ -0,0 +1,121 @@
+#include "Parallel.h"
+
+static thread_local bool inside_job = false;
+
+// Set by runSerially() for the whole process, not just the calling thread: after fork() the
+// pool's workers list names threads that only exist in the parent
+static std::atomic<bool> serial = false;
+
+ThreadPool::ThreadPool() {
+  next_chunk = 0;
+
+  unsigned hardware_threads = std::thread::hardware_concurrency();
+
+  for (unsigned i = 1; i < hardware_threads; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  wake.notify_all();
+
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+void runSerially() {
+  serial = true;
+}
+
+ThreadPool& ThreadPool::instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+size_t ThreadPool::threadCount() const noexcept {
+  return serial ? 1 : workers.size() + 1;
+}
+
+void ThreadPool::run(size_t count, Job const& job) {
+  if (count == 0) {
+    return;
+  }
+
+  if (workers.empty() || inside_job || serial || count == 1) {
+    job(0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->job = &job;
+    job_count = count;
+
+    // A few chunks per thread so uneven chunks even out
+    size_t chunks = threadCount() * 4;
+    chunk_size = (count + chunks - 1) / chunks;
+
+    next_chunk = 0;
+    busy_workers = workers.size();
+    ++generation;
+  }
+
+  wake.notify_all();
+
+  inside_job = true;
+  runChunks();
+  inside_job = false;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return busy_workers == 0; });
+
+  this->job = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+  uint64_t seen_generation = 0;
+
+  inside_job = true;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+
+      if (stopping) {
+        return;
+      }
+
+      seen_generation = generation;
+    }
+
+    runChunks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      --busy_workers;
+    }
+
+    done.notify_one();
+  }
+}
+
+void ThreadPool::runChunks() {
+  while (true) {
+    size_t begin = next_chunk.fetch_add(chunk_size);
+
+    if (begin >= job_count) {
+      break;
+    }
+
+    size_t end = begin + chunk_size < job_count ? begin + chunk_size : job_count;
+    (*job)(begin, end);
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads, one per hardware thread (the calling thread counts as one).
+// Jobs can't be nested: parallelFor() called from inside a job runs serially.
+class ThreadPool {
+public:
+  using Job = std::function<void(size_t begin, size_t end)>;
+
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  Job const* job = nullptr;
+  size_t job_count = 0;
+  size_t chunk_size = 0;
+  uint64_t generation = 0;
+  bool stopping = false;
+
+  std::atomic<size_t> next_chunk;
+  size_t busy_workers = 0;
+
+public:
+  ThreadPool();
+  ~ThreadPool();
+
+  static ThreadPool& instance();
+
+public:
+  size_t threadCount() const noexcept;
+
+  // Calls job over [0, count) split into contiguous chunks, returns when all chunks are done
+  void run(size_t count, Job const& job);
+
+private:
+  void workerLoop();
+  void runChunks();
+};
+
+template <typename F>
+inline void parallelFor(size_t count, F&& fn) {
+  // run() is done with fn when it returns, a reference is enough and fits Job without allocating
+  ThreadPool::instance().run(count, ThreadPool::Job(std::ref(fn)));
+}
+
+inline size_t threadCount() {
+  return ThreadPool::instance().threadCount();
+}
+
+// parallelFor() on any thread runs serially from now on, and threadCount() is 1. For forked
+// children, which inherit the pool but not its worker threads
+void runSerially();
@@ -0,0 +1,215 @@
+#include "Parareal.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+#include "Parallel.h"
+
+#define YOSHIDA_W1 ( 1.3512071919596578 )  // 1 / (2 - 2^(1/3))
+#define YOSHIDA_W0 ( -1.7024143839193155 ) // -2^(1/3) * W1
+
+Parareal::Parareal(uint32_t window_count, uint32_t window_ticks, double tolerance, bool blocking) {
+  this->window_count = window_count;
+  this->window_ticks = window_ticks;
+  this->tolerance = tolerance;
+  this->blocking = blocking;
+
+  solving = false;
+}
+
+Parareal::~Parareal() {
+  if (solver.joinable()) {
+    solver.join();
+  }
+}
+
+void Parareal::step(std::vector<Planet>& planets) {
+  size_t count = planets.size();
+
+  if (count == 0) {
+    return;
+  }
+
+  if (played_ticks >= trajectory_ticks) {
+    // First span, starts in the frame planets are in now
+    if (!solver.joinable()) {
+      offset = Vector2d();
+      startSolve(planets);
+    }
+
+    if (solving && !blocking) {
+      return;
+    }
+
+    solver.join();
+
+    trajectory.swap(solved);
+    trajectory_ticks = solved_ticks;
+    iterations = solved_iterations;
+    played_ticks = 0;
+
+    // The next span starts where this one ends
+    std::vector<Planet> end(trajectory.end() - count, trajectory.end());
+    startSolve(end);
+  }
+
+  Planet const* state = &trajectory[played_ticks * count];
+
+  for (size_t i = 0; i < count; ++i) {
+    planets[i] = state[i];
+    planets[i].move(StateVector(offset));
+  }
+
+  ++played_ticks;
+}
+
+void Parareal::solve(std::vector<Planet> const& planets) {
+  size_t windows = window_count ? window_count : threadCount();
+  size_t count = planets.size();
+
+  starts.assign(windows + 1, planets);
+  coarse.resize(windows);
+  fine.resize(windows);
+  integrators.resize(windows);
+
+  solved.assign(windows * window_ticks * count, planets[0]);
+  solved_ticks = windows * window_ticks;
+
+  // Iteration zero is the coarse solution alone
+  for (size_t n = 0; n < windows; ++n) {
+    coarse[n] = starts[n];
+    coarsePropagate(coarse[n]);
+    starts[n + 1] = coarse[n];
+  }
+
+  std::vector<Planet> predicted;
+
+  // Window k starts exactly after k iterations, so windows is the most ever needed
+  for (solved_iterations = 0; solved_iterations < windows; ++solved_iterations) {
+    size_t first = solved_iterations;
+
+    parallelFor(windows - first, [&](size_t begin, size_t end) {
+      for (size_t n = first + begin; n < first + end; ++n) {
+        finePropagate(n);
+      }
+    });
+
+    double change = 0.0;
+
+    for (size_t n = first; n < windows; ++n) {
+      predicted = starts[n];
+      coarsePropagate(predicted);
+
+      std::vector<Planet>& next = starts[n + 1];
+
+      for (size_t i = 0; i < count; ++i) {
+        Vector2d position = Vector2d(predicted[i].position) + Vector2d(fine[n][i].position) - Vector2d(coarse[n][i].position);
+        Vector2d velocity = Vector2d(predicted[i].velocity) + Vector2d(fine[n][i].velocity) - Vector2d(coarse[n][i].velocity);
+
+        change = fmax(change, (position - Vector2d(next[i].position)).length());
+
+        next[i].position = PositionVector(position);
+        next[i].velocity = StateVector(velocity);
+      }
+
+      coarse[n].swap(predicted);
+    }
+
+    if (change <= tolerance) {
+      ++solved_iterations;
+      break;
+    }
+  }
+}
+
+void Parareal::move(Vector2d shift) {
+  offset += shift;
+}
+
+void Parareal::startSolve(std::vector<Planet> const& planets) {
+  solving = true;
+
+  solver = std::thread([this, planets] {
+    solve(planets);
+    solving = false;
+  });
+}
+
+// Yoshida's 4th order composition of drift-kick-drift leapfrogs with direct forces, one step per
+// tick. Parareal on orbits only converges when the coarse phase error stays small over a window,
+// which a plain leapfrog at a tick per step doesn't manage
+void Parareal::coarsePropagate(std::vector<Planet>& planets) {
+  size_t count = planets.size();
+
+  accelerations.resize(count);
+
+  auto accelerate = [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      accelerations[i] = Vector2d();
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t j = i + 1; j < count; ++j) {
+        Vector2d diff = Vector2d(planets[j].position) - Vector2d(planets[i].position);
+        double distance2 = diff.x * diff.x + diff.y * diff.y;
+
+        if (distance2 == 0.0) {
+          continue;
+        }
+
+        Vector2d pull = diff * (G / (distance2 * sqrt(distance2)));
+
+        accelerations[i] += pull * double(planets[j].mass);
+        accelerations[j] -= pull * double(planets[i].mass);
+      }
+    }
+  };
+
+  auto kick = [&](double dt) {
+    for (size_t i = 0; i < count; ++i) {
+      // Tracers take accelerations as their punches
+      double inertia = planets[i].isTracer() ? 1.0 : double(planets[i].mass);
+      planets[i].punch(StateVector(accelerations[i] * (inertia * dt)));
+    }
+  };
+
+  auto drift = [&](double dt) {
+    for (Planet& planet : planets) {
+      Vector2d velocity = planet.isTracer() ? Vector2d(planet.velocity) : Vector2d(planet.velocity) / double(planet.mass);
+      planet.move(StateVector(velocity * dt));
+    }
+  };
+
+  for (uint32_t tick = 0; tick < window_ticks; ++tick) {
+    drift(YOSHIDA_W1 / 2);
+    accelerate();
+    kick(YOSHIDA_W1);
+    drift((YOSHIDA_W0 + YOSHIDA_W1) / 2);
+    accelerate();
+    kick(YOSHIDA_W0);
+    drift((YOSHIDA_W0 + YOSHIDA_W1) / 2);
+    accelerate();
+    kick(YOSHIDA_W1);
+    drift(YOSHIDA_W1 / 2);
+  }
+}
+
+void Parareal::finePropagate(size_t window) {
+  size_t count = starts[window].size();
+
+  std::vector<Planet>& planets = fine[window];
+  planets = starts[window];
+
+  HermiteIntegrator& integrator = integrators[window];
+  integrator.invalidate();
+
+  Planet* recorded = &solved[window * window_ticks * count];
+
+  for (uint32_t tick = 0; tick < window_ticks; ++tick) {
+    integrator.step(planets);
+
+    for (size_t i = 0; i < count; ++i) {
+      *recorded++ = planets[i];
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Hermite.h"
+#include "Planet.h"
+
+// Parareal parallel-in-time integration (Lions, Maday & Turinici 2001) for systems too small
+// to split in space. A span of window_count * window_ticks ticks is cut into windows: a cheap
+// coarse propagator (one leapfrog step per tick) sweeps them serially, the Hermite integrator
+// runs every window in parallel from the current window starts, and the starts are corrected
+// with U[n+1] = G(U[n]) + F(U_old[n]) - G(U_old[n]) until they move less than tolerance.
+// The fine trajectories are kept tick by tick and played back by step(). The next span is
+// solved on a background thread from the end of the current one while that plays
+class Parareal {
+public:
+  uint32_t window_count; // 0 for one window per thread
+  uint32_t window_ticks;
+  double   tolerance;    // pixels
+  bool     blocking;     // step() waits for a span instead of leaving planets as they are
+
+  std::vector<std::vector<Planet>> starts; // U[n], window_count + 1 of them
+  std::vector<std::vector<Planet>> coarse; // G(U_old[n])
+  std::vector<std::vector<Planet>> fine;   // F(U_old[n])
+
+  std::vector<HermiteIntegrator> integrators;
+
+  // Fine states, planet count per tick
+  std::vector<Planet> trajectory;
+  size_t trajectory_ticks = 0;
+  size_t played_ticks = 0;
+
+  // Written by solve(), swapped into trajectory once the solver thread is done
+  std::vector<Planet> solved;
+  size_t solved_ticks = 0;
+
+  std::thread solver;
+  std::atomic<bool> solving;
+
+  Vector2d offset; // rebases since the first span was started, spans continue each other
+
+  uint32_t iterations = 0; // of the span playing
+  uint32_t solved_iterations = 0;
+
+  std::vector<Vector2d> accelerations;
+
+public:
+  Parareal(uint32_t window_count = 0, uint32_t window_ticks = 1000, double tolerance = 1e-3, bool blocking = false);
+  ~Parareal();
+
+public:
+  // Advances planets by one tick. Unless blocking, never waits for a solve: until the first span
+  // is ready planets are left as they are, the thread pool belongs to the solver thread meanwhile.
+  // Headless runs need blocking, or they'd count the held ticks as integrated ones
+  void step(std::vector<Planet>& planets);
+
+  // Solves the span starting at planets into solved, synchronously
+  void solve(std::vector<Planet> const& planets);
+
+  // Shifts the unplayed part of the span along with a rebase
+  void move(Vector2d shift);
+
+private:
+  void startSolve(std::vector<Planet> const& planets);
+
+  void coarsePropagate(std::vector<Planet>& planets);
+  void finePropagate(size_t window);
+};
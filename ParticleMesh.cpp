@@ -0,0 +1,230 @@
+#include "ParticleMesh.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+#include "Parallel.h"
+
+static constexpr double PI_DOUBLE = 3.141592653589793;
+
+ParticleMesh::ParticleMesh(size_t grid_size, double box_size)
+  : fft(grid_size)
+{
+  this->grid_size = grid_size;
+  this->box_size = box_size;
+  this->cell_size = box_size / grid_size;
+
+  mesh.resize(grid_size * grid_size);
+  field.resize(grid_size * grid_size);
+
+  double softening = cell_size;
+
+  setKernel([softening](double r) {
+    return -1.0 / sqrt(r * r + softening * softening);
+  });
+}
+
+void ParticleMesh::setKernel(std::function<double(double)> const& potential, bool deconvolve) {
+  size_t n = grid_size;
+
+  green.resize(n * n);
+
+  parallelFor(n, [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; ++row) {
+      // Nearest periodic image of the offset
+      double dy = (row < n / 2 ? double(row) : double(row) - n) * cell_size;
+
+      for (size_t col = 0; col < n; ++col) {
+        double dx = (col < n / 2 ? double(col) : double(col) - n) * cell_size;
+
+        green[row * n + col] = G * potential(sqrt(dx * dx + dy * dy));
+      }
+    }
+  });
+
+  fft.transform2D(green.data(), false);
+
+  if (!deconvolve) {
+    return;
+  }
+
+  // Undo the smoothing of cloud-in-cell assignment and interpolation, sinc^2 each per axis
+  auto window = [n](size_t mode) {
+    double k = PI_DOUBLE * (mode < n / 2 ? double(mode) : double(mode) - n) / n;
+    double sinc = k != 0.0 ? sin(k) / k : 1.0;
+    return sinc * sinc;
+  };
+
+  parallelFor(n, [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; ++row) {
+      double window_y = window(row);
+
+      for (size_t col = 0; col < n; ++col) {
+        double window_xy = window(col) * window_y;
+        green[row * n + col] /= window_xy * window_xy;
+      }
+    }
+  });
+}
+
+void ParticleMesh::apply(std::vector<Planet>& planets) {
+  wrap(planets);
+
+  assignMass(planets);
+  solvePotential();
+  computeField();
+  interpolateForces(planets);
+}
+
+void ParticleMesh::wrap(std::vector<Planet>& planets) const {
+  double half = box_size / 2;
+
+  parallelFor(planets.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Vector2d position = Vector2d(planets[i].position);
+      Vector2d shift;
+
+      shift.x = -floor((position.x + half) / box_size) * box_size;
+      shift.y = -floor((position.y + half) / box_size) * box_size;
+
+      if (shift.x != 0.0 || shift.y != 0.0) {
+        planets[i].move(StateVector(shift));
+      }
+    }
+  });
+}
+
+ParticleMesh::CloudInCell ParticleMesh::cloudInCell(Vector2d position) const noexcept {
+  // Cell centres sit at (i + 0.5) * cell_size from the box corner
+  double u = (position.x + box_size / 2) / cell_size - 0.5;
+  double v = (position.y + box_size / 2) / cell_size - 0.5;
+
+  double cell_x = floor(u);
+  double cell_y = floor(v);
+
+  double fx = u - cell_x;
+  double fy = v - cell_y;
+
+  long n = long(grid_size);
+  long x0 = ((long(cell_x) % n) + n) % n;
+  long y0 = ((long(cell_y) % n) + n) % n;
+
+  CloudInCell cic;
+  cic.x0 = size_t(x0);
+  cic.y0 = size_t(y0);
+  cic.x1 = size_t((x0 + 1) % n);
+  cic.y1 = size_t((y0 + 1) % n);
+
+  cic.w00 = (1 - fx) * (1 - fy);
+  cic.w10 = fx * (1 - fy);
+  cic.w01 = (1 - fx) * fy;
+  cic.w11 = fx * fy;
+
+  return cic;
+}
+
+void ParticleMesh::assignMass(std::vector<Planet> const& planets) {
+  size_t n = grid_size;
+  size_t slices = threadCount();
+
+  thread_density.resize(slices);
+
+  // Every slice deposits into its own grid, so no atomics are needed
+  parallelFor(slices, [&](size_t begin, size_t end) {
+    for (size_t slice = begin; slice < end; ++slice) {
+      std::vector<double>& density = thread_density[slice];
+      density.assign(n * n, 0.0);
+
+      size_t first = planets.size() * slice / slices;
+      size_t last = planets.size() * (slice + 1) / slices;
+
+      for (size_t i = first; i < last; ++i) {
+        CloudInCell cic = cloudInCell(Vector2d(planets[i].position));
+        double mass = planets[i].mass;
+
+        density[cic.y0 * n + cic.x0] += mass * cic.w00;
+        density[cic.y0 * n + cic.x1] += mass * cic.w10;
+        density[cic.y1 * n + cic.x0] += mass * cic.w01;
+        density[cic.y1 * n + cic.x1] += mass * cic.w11;
+      }
+    }
+  });
+
+  parallelFor(n * n, [&](size_t begin, size_t end) {
+    for (size_t cell = begin; cell < end; ++cell) {
+      double mass = 0.0;
+
+      for (std::vector<double> const& density : thread_density) {
+        mass += density[cell];
+      }
+
+      mesh[cell] = mass;
+    }
+  });
+}
+
+void ParticleMesh::solvePotential() {
+  size_t cells = grid_size * grid_size;
+
+  fft.transform2D(mesh.data(), false);
+
+  parallelFor(cells, [&](size_t begin, size_t end) {
+    for (size_t cell = begin; cell < end; ++cell) {
+      mesh[cell] *= green[cell];
+    }
+  });
+
+  fft.transform2D(mesh.data(), true);
+
+  double normalisation = 1.0 / cells;
+
+  parallelFor(cells, [&](size_t begin, size_t end) {
+    for (size_t cell = begin; cell < end; ++cell) {
+      mesh[cell] = mesh[cell].real() * normalisation;
+    }
+  });
+}
+
+void ParticleMesh::computeField() {
+  size_t n = grid_size;
+
+  auto potential = [&](size_t row, size_t col) {
+    return mesh[(row % n) * n + (col % n)].real();
+  };
+
+  // Fourth order central difference, acceleration is minus the gradient
+  parallelFor(n, [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; ++row) {
+      for (size_t col = 0; col < n; ++col) {
+        double dx =
+          8.0 * (potential(row, col + 1) - potential(row, col + n - 1)) -
+                (potential(row, col + 2) - potential(row, col + n - 2));
+
+        double dy =
+          8.0 * (potential(row + 1, col) - potential(row + n - 1, col)) -
+                (potential(row + 2, col) - potential(row + n - 2, col));
+
+        field[row * n + col] = Vector2d(dx, dy) / (-12.0 * cell_size);
+      }
+    }
+  });
+}
+
+void ParticleMesh::interpolateForces(std::vector<Planet>& planets) const {
+  size_t n = grid_size;
+
+  parallelFor(planets.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Planet& planet = planets[i];
+      CloudInCell cic = cloudInCell(Vector2d(planet.position));
+
+      Vector2d acceleration =
+        field[cic.y0 * n + cic.x0] * cic.w00 +
+        field[cic.y0 * n + cic.x1] * cic.w10 +
+        field[cic.y1 * n + cic.x0] * cic.w01 +
+        field[cic.y1 * n + cic.x1] * cic.w11;
+
+      planet.punch(StateVector(acceleration * double(planet.mass)));
+    }
+  });
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "FFT.h"
+#include "Planet.h"
+
+// Particle-mesh gravity in a periodic square box of box_size centred on the simulation origin.
+// Mass is assigned to the grid with cloud-in-cell weights, the potential is the FFT convolution
+// with the kernel sampled on the grid (nearest periodic image), forces are its finite difference
+// interpolated back with the same weights. Cost is O(N + G^2 log G) per tick.
+class ParticleMesh {
+public:
+  size_t grid_size; // cells per side, power of two
+  double box_size;  // pixels
+  double cell_size; // pixels
+
+  FFT fft;
+
+  std::vector<Complex> green;                      // transformed kernel, G included
+  std::vector<std::vector<double>> thread_density; // per thread mass assignment
+  std::vector<Complex> mesh;                       // density, then potential
+  std::vector<Vector2d> field;                     // acceleration per cell
+
+public:
+  ParticleMesh(size_t grid_size, double box_size);
+
+public:
+  // potential(r) is the potential of a unit mass at distance r (without G).
+  // Defaults to the Newtonian 1 / r of applyGravity, softened over one cell.
+  // Kernels that are smooth on the grid scale can be deconvolved by the CIC window
+  void setKernel(std::function<double(double)> const& potential, bool deconvolve = false);
+
+  // Wraps planets into the box and punches them with the mesh force
+  void apply(std::vector<Planet>& planets);
+
+  void wrap(std::vector<Planet>& planets) const;
+
+  void assignMass(std::vector<Planet> const& planets);
+  void solvePotential();
+  void computeField();
+  void interpolateForces(std::vector<Planet>& planets) const;
+
+private:
+  struct CloudInCell {
+    size_t x0, y0, x1, y1;
+    double w00, w01, w10, w11;
+  };
+
+  CloudInCell cloudInCell(Vector2d position) const noexcept;
+};
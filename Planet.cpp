@@ -1,21 +1,21 @@
 #include "Planet.h"
 
-Planet::Planet(Vector2 position, double mass, double radius, uint32_t color) {
+Planet::Planet(StateVector position, double mass, double radius, uint32_t color) {
   this->position = position;
   this->mass = mass;
   this->radius = radius;
   this->color = color;
-  this->velocity = Vector2();
+  this->velocity = StateVector();
 }
 
 void Planet::tick() {
-  move(velocity / mass);
+  move(isTracer() ? velocity : velocity / mass);
 }
 
-void Planet::punch(Vector2 value) {
+void Planet::punch(StateVector value) {
   velocity += value;
 }
 
-void Planet::move(Vector2 value) {
+void Planet::move(StateVector value) {
   position += value;
 }
@@ -2,22 +2,28 @@
 
 #include <stdint.h>
 
-#include "Vector.h"
+#include "Precision.h"
 
+// Planets with zero mass are tracers: they feel gravity but pull nothing, and their
+// velocity is a plain velocity, punches carry accelerations instead of forces
 class Planet {
 public:
-  Vector2   position;
-  double    mass;     // KG
-  double    radius;   // pixels
-  uint32_t  color;    // RGB
-  Vector2   velocity; // pixels / KG * second
+  PositionVector position;
+  StateScalar    mass;     // KG
+  double         radius;   // pixels
+  uint32_t       color;    // RGB
+  StateVector    velocity; // pixels / KG * second, pixels / second for tracers
 
 public:
-  Planet(Vector2 position, double mass, double radius, uint32_t color);
+  Planet(StateVector position, double mass, double radius, uint32_t color);
 
 public:
-  void punch(Vector2 value);
-  void move(Vector2 value);
+  void punch(StateVector value);
+  void move(StateVector value);
 
   void tick();
+
+  inline bool isTracer() const noexcept {
+    return mass == 0;
+  }
 };
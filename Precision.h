@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Vector.h"
+#include "DoubleFloat.h"
+
+// Scalar types of the physics pipeline, selected with SIMULATION_PRECISION:
+//   PRECISION_FLOAT  - float state, float force kernels
+//   PRECISION_DOUBLE - double state, double force kernels
+//   PRECISION_MIXED  - double state (positions, momenta), float force kernels
+//   PRECISION_DOUBLE_FLOAT - hi/lo float pair positions, double momenta, float force kernels
+#define PRECISION_FLOAT  0
+#define PRECISION_DOUBLE 1
+#define PRECISION_MIXED  2
+#define PRECISION_DOUBLE_FLOAT 3
+
+#ifndef SIMULATION_PRECISION
+#define SIMULATION_PRECISION PRECISION_MIXED
+#endif
+
+#if SIMULATION_PRECISION == PRECISION_FLOAT
+using StateScalar = float;
+using ForceScalar = float;
+#define PRECISION_NAME "float"
+#elif SIMULATION_PRECISION == PRECISION_DOUBLE
+using StateScalar = double;
+using ForceScalar = double;
+#define PRECISION_NAME "double"
+#elif SIMULATION_PRECISION == PRECISION_MIXED
+using StateScalar = double;
+using ForceScalar = float;
+#define PRECISION_NAME "mixed"
+#elif SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT
+using StateScalar = double;
+using ForceScalar = float;
+#define PRECISION_NAME "double-float"
+#else
+#error Unknown SIMULATION_PRECISION
+#endif
+
+using StateVector = TVector2<StateScalar>;
+using ForceVector = TVector2<ForceScalar>;
+
+#if SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT
+using PositionVector = DFVector2;
+#else
+using PositionVector = StateVector;
+#endif
@@ -0,0 +1,720 @@
+#include "QuadTree.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "Morton.h"
+#include "Parallel.h"
+
+// Keys have two bits per level, below that bodies are as good as coincident
+#define MAX_TREE_DEPTH ( 32 )
+
+QuadTree::QuadTree(uint32_t multipole_order, double theta)
+  : expansion(multipole_order)
+{
+  this->multipole_order = multipole_order;
+  this->theta = theta;
+}
+
+// Quadrant of the depth cell the key falls into, same numbering as Node::children
+static inline uint32_t quadrantDigit(uint64_t key, uint32_t depth) {
+  return static_cast<uint32_t>(key >> (62 - 2 * depth)) & 3;
+}
+
+static inline Vector2d childCenter(Vector2d center, double half_size, uint32_t quadrant) {
+  double quarter = half_size / 2;
+
+  return Vector2d(
+    center.x + ((quadrant & 1) ? quarter : -quarter),
+    center.y + ((quadrant & 2) ? quarter : -quarter)
+  );
+}
+
+template <typename F>
+void QuadTree::bottomUp(F const& fn) {
+  parallelFor(subtrees.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Subtree const& subtree = subtrees[i];
+
+      // Children are stored after their parent, backwards every child is done first
+      for (uint32_t index = subtree.index + subtree.node_count; index-- > subtree.index;) {
+        fn(static_cast<int32_t>(index));
+      }
+    }
+  });
+
+  for (size_t i = top_nodes.size(); i-- > 0;) {
+    fn(top_nodes[i]);
+  }
+}
+
+void QuadTree::build(std::vector<Planet> const& planets) {
+  uint32_t count = static_cast<uint32_t>(planets.size());
+
+  positions.resize(count);
+  masses.resize(count);
+  order.resize(count);
+  keys.resize(count);
+
+  nodes.clear();
+  leaves.clear();
+
+  if (count == 0) {
+    return;
+  }
+
+  Vector2d min = Vector2d(planets[0].position);
+  Vector2d max = min;
+
+  std::mutex bounds_mutex;
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    Vector2d chunk_min = Vector2d(planets[begin].position);
+    Vector2d chunk_max = chunk_min;
+
+    for (size_t i = begin; i < end; ++i) {
+      Vector2d position = Vector2d(planets[i].position);
+
+      positions[i] = position;
+      masses[i] = planets[i].mass;
+
+      chunk_min.x = fmin(chunk_min.x, position.x); chunk_min.y = fmin(chunk_min.y, position.y);
+      chunk_max.x = fmax(chunk_max.x, position.x); chunk_max.y = fmax(chunk_max.y, position.y);
+    }
+
+    std::lock_guard<std::mutex> lock(bounds_mutex);
+
+    min.x = fmin(min.x, chunk_min.x); min.y = fmin(min.y, chunk_min.y);
+    max.x = fmax(max.x, chunk_max.x); max.y = fmax(max.y, chunk_max.y);
+  });
+
+  Vector2d center;
+  double half_size;
+
+  if (box_size > 0.0) {
+    center = Vector2d();
+    half_size = box_size / 2;
+  }
+  else {
+    center = (min + max) / 2;
+    half_size = fmax(max.x - min.x, max.y - min.y) / 2 * 1.0001 + 1e-9;
+  }
+
+  // Morton keys relative to the root cell, the top two bits pick the root quadrant and so on
+  double scale = 4294967296.0 / (half_size * 2);
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      double x = (positions[i].x - (center.x - half_size)) * scale;
+      double y = (positions[i].y - (center.y - half_size)) * scale;
+
+      // Bodies outside a periodic box go to the edge cells
+      x = fmin(fmax(x, 0.0), 4294967295.0);
+      y = fmin(fmax(y, 0.0), 4294967295.0);
+
+      keys[i] = mortonKey(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+      order[i] = static_cast<uint32_t>(i);
+    }
+  });
+
+  radixSort(keys, order, key_scratch, scratch);
+
+  // Enough subtrees below the top levels to keep every thread busy
+  subtree_depth = 1;
+
+  while (subtree_depth < 8 && (size_t(1) << (2 * subtree_depth)) < threadCount() * 4) {
+    ++subtree_depth;
+  }
+
+  root_half_size = half_size;
+
+  subtrees.clear();
+
+  uint32_t node_count = collectSubtrees(center, half_size, 0, count, 0);
+
+  parallelFor(subtrees.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      subtrees[i].node_count = countNodes(subtrees[i].first, subtrees[i].count, subtrees[i].depth);
+    }
+  });
+
+  for (Subtree const& subtree : subtrees) {
+    node_count += subtree.node_count;
+  }
+
+  nodes.resize(node_count);
+  top_nodes.clear();
+
+  // Top levels lay out the array and leave a gap of the right size for every subtree
+  uint32_t cursor = 0;
+  uint32_t next_subtree = 0;
+
+  buildTop(cursor, next_subtree, center, half_size, 0, count, 0);
+
+  parallelFor(subtrees.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Subtree const& subtree = subtrees[i];
+      uint32_t subtree_cursor = subtree.index;
+
+      buildNode(subtree_cursor, subtree.center, subtree.half_size, subtree.first, subtree.count, subtree.depth);
+    }
+  });
+
+  for (size_t i = top_nodes.size(); i-- > 0;) {
+    computeMoments(top_nodes[i]);
+  }
+
+  for (int32_t index = 0; index < static_cast<int32_t>(nodes.size()); ++index) {
+    if (nodes[index].isLeaf()) {
+      leaves.push_back(index);
+    }
+  }
+
+  if (multipole_order > 1) {
+    multipoles.assign(nodes.size() * expansion.terms, 0.0);
+
+    bottomUp([&](int32_t index) {
+      computeMultipoles(index);
+    });
+  }
+
+  built_body_count = count;
+  built_extent = leafExtent();
+}
+
+void QuadTree::update(std::vector<Planet> const& planets) {
+  uint32_t count = static_cast<uint32_t>(planets.size());
+
+  if (refit_tolerance <= 0.0 || nodes.empty() || count != built_body_count) {
+    build(planets);
+    return;
+  }
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      positions[i] = Vector2d(planets[i].position);
+      masses[i] = planets[i].mass;
+    }
+  });
+
+  bottomUp([&](int32_t index) {
+    refitBounds(index);
+    computeMoments(index);
+  });
+
+  // Bodies drifted apart, cells overlap too much for the walk to stay cheap
+  if (leafExtent() > built_extent * refit_tolerance) {
+    build(planets);
+    return;
+  }
+
+  if (multipole_order > 1) {
+    multipoles.assign(nodes.size() * expansion.terms, 0.0);
+
+    bottomUp([&](int32_t index) {
+      computeMultipoles(index);
+    });
+  }
+}
+
+void QuadTree::invalidate() {
+  nodes.clear();
+  leaves.clear();
+}
+
+void QuadTree::refitBounds(int32_t index) {
+  Node& node = nodes[index];
+
+  Vector2d min, max;
+
+  if (node.isLeaf()) {
+    min = max = positions[order[node.first]];
+
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      Vector2d const& position = positions[order[i]];
+
+      min.x = fmin(min.x, position.x); min.y = fmin(min.y, position.y);
+      max.x = fmax(max.x, position.x); max.y = fmax(max.y, position.y);
+    }
+  }
+  else {
+    min = Vector2d(INFINITY, INFINITY);
+    max = Vector2d(-INFINITY, -INFINITY);
+
+    for (int32_t child : node.children) {
+      if (child < 0) {
+        continue;
+      }
+
+      Node const& other = nodes[child];
+
+      min.x = fmin(min.x, other.center.x - other.half_size); min.y = fmin(min.y, other.center.y - other.half_size);
+      max.x = fmax(max.x, other.center.x + other.half_size); max.y = fmax(max.y, other.center.y + other.half_size);
+    }
+  }
+
+  // Still a square, the walks only know cells by centre and half size. Never smaller than
+  // the built cell, theta would accept tight cells much earlier
+  node.center = (min + max) / 2;
+  node.half_size = fmax(fmax(max.x - min.x, max.y - min.y) / 2, ldexp(root_half_size, -int(node.depth)));
+}
+
+double QuadTree::leafExtent() const {
+  double total = 0.0;
+  std::mutex total_mutex;
+
+  parallelFor(leaves.size(), [&](size_t begin, size_t end) {
+    double sum = 0.0;
+
+    for (size_t i = begin; i < end; ++i) {
+      Node const& node = nodes[leaves[i]];
+
+      Vector2d min = positions[order[node.first]];
+      Vector2d max = min;
+
+      for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+        Vector2d const& position = positions[order[j]];
+
+        min.x = fmin(min.x, position.x); min.y = fmin(min.y, position.y);
+        max.x = fmax(max.x, position.x); max.y = fmax(max.y, position.y);
+      }
+
+      sum += fmax(max.x - min.x, max.y - min.y);
+    }
+
+    std::lock_guard<std::mutex> lock(total_mutex);
+    total += sum;
+  });
+
+  return total;
+}
+
+void QuadTree::computeMultipoles(int32_t index) {
+  Node const& node = nodes[index];
+  double* multipole = &multipoles[index * expansion.terms];
+
+  if (node.isLeaf()) {
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      uint32_t body = order[i];
+      expansion.addParticle(positions[body] - node.mass_center, masses[body], multipole);
+    }
+
+    return;
+  }
+
+  for (int32_t child : node.children) {
+    if (child >= 0) {
+      expansion.shiftMultipole(&multipoles[child * expansion.terms], nodes[child].mass_center - node.mass_center, multipole);
+    }
+  }
+}
+
+void QuadTree::splitRange(uint32_t first, uint32_t count, uint32_t depth, uint32_t* starts) const {
+  // Bodies in the range share all digits above depth, so each quadrant is one run of the sorted keys
+  uint64_t const* begin = &keys[first];
+  uint64_t const* end = begin + count;
+
+  starts[0] = first;
+
+  for (uint32_t quadrant = 1; quadrant < 4; ++quadrant) {
+    uint64_t const* split = std::partition_point(begin, end, [&](uint64_t key) {
+      return quadrantDigit(key, depth) < quadrant;
+    });
+
+    starts[quadrant] = first + static_cast<uint32_t>(split - begin);
+  }
+
+  starts[4] = first + count;
+}
+
+uint32_t QuadTree::countNodes(uint32_t first, uint32_t count, uint32_t depth) const {
+  uint32_t total = 1;
+
+  if (count > leaf_size && depth < MAX_TREE_DEPTH) {
+    uint32_t starts[5];
+    splitRange(first, count, depth, starts);
+
+    for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+      if (starts[quadrant + 1] > starts[quadrant]) {
+        total += countNodes(starts[quadrant], starts[quadrant + 1] - starts[quadrant], depth + 1);
+      }
+    }
+  }
+
+  return total;
+}
+
+uint32_t QuadTree::collectSubtrees(Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth) {
+  bool splits = count > leaf_size && depth < MAX_TREE_DEPTH;
+
+  if (splits && depth == subtree_depth) {
+    Subtree subtree;
+    subtree.center = center;
+    subtree.half_size = half_size;
+    subtree.first = first;
+    subtree.count = count;
+    subtree.depth = depth;
+
+    subtrees.push_back(subtree);
+    return 0;
+  }
+
+  uint32_t top_count = 1;
+
+  if (splits) {
+    uint32_t starts[5];
+    splitRange(first, count, depth, starts);
+
+    for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+      if (starts[quadrant + 1] > starts[quadrant]) {
+        top_count += collectSubtrees(
+          childCenter(center, half_size, quadrant), half_size / 2,
+          starts[quadrant], starts[quadrant + 1] - starts[quadrant], depth + 1
+        );
+      }
+    }
+  }
+
+  return top_count;
+}
+
+void QuadTree::initNode(int32_t index, Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth) {
+  Node& node = nodes[index];
+
+  node.center = center;
+  node.half_size = half_size;
+  node.first = first;
+  node.count = count;
+  node.depth = depth;
+
+  for (int32_t& child : node.children) {
+    child = -1;
+  }
+}
+
+int32_t QuadTree::buildTop(uint32_t& cursor, uint32_t& next_subtree, Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth) {
+  bool splits = count > leaf_size && depth < MAX_TREE_DEPTH;
+
+  // Same order as collectSubtrees(), so the next subtree is this one
+  if (splits && depth == subtree_depth) {
+    Subtree& subtree = subtrees[next_subtree++];
+
+    subtree.index = cursor;
+    cursor += subtree.node_count;
+
+    return static_cast<int32_t>(subtree.index);
+  }
+
+  int32_t index = static_cast<int32_t>(cursor++);
+
+  initNode(index, center, half_size, first, count, depth);
+  top_nodes.push_back(index);
+
+  if (splits) {
+    uint32_t starts[5];
+    splitRange(first, count, depth, starts);
+
+    for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+      if (starts[quadrant + 1] > starts[quadrant]) {
+        nodes[index].children[quadrant] = buildTop(
+          cursor, next_subtree,
+          childCenter(center, half_size, quadrant), half_size / 2,
+          starts[quadrant], starts[quadrant + 1] - starts[quadrant], depth + 1
+        );
+      }
+    }
+  }
+
+  nodes[index].next = cursor;
+
+  return index;
+}
+
+int32_t QuadTree::buildNode(uint32_t& cursor, Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth) {
+  int32_t index = static_cast<int32_t>(cursor++);
+
+  initNode(index, center, half_size, first, count, depth);
+
+  if (count > leaf_size && depth < MAX_TREE_DEPTH) {
+    uint32_t starts[5];
+    splitRange(first, count, depth, starts);
+
+    for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+      if (starts[quadrant + 1] > starts[quadrant]) {
+        nodes[index].children[quadrant] = buildNode(
+          cursor,
+          childCenter(center, half_size, quadrant), half_size / 2,
+          starts[quadrant], starts[quadrant + 1] - starts[quadrant], depth + 1
+        );
+      }
+    }
+  }
+
+  nodes[index].next = cursor;
+
+  // Children are complete by now
+  computeMoments(index);
+
+  return index;
+}
+
+void QuadTree::computeMoments(int32_t index) {
+  Node& node = nodes[index];
+
+  double mass = 0.0;
+  Vector2d weighted;
+
+  for (int32_t child : node.children) {
+    if (child >= 0) {
+      mass += nodes[child].mass;
+      weighted += nodes[child].mass_center * nodes[child].mass;
+    }
+  }
+
+  if (node.isLeaf()) {
+    for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+      uint32_t body = order[i];
+
+      mass += masses[body];
+      weighted += positions[body] * masses[body];
+    }
+  }
+
+  node.mass = mass;
+  node.mass_center = mass > 0.0 ? weighted / mass : node.center;
+}
+
+void QuadTree::InteractionList::clear() {
+  for (std::vector<float>* column : { &x, &y, &gm, &cell_x, &cell_y, &m00, &m20, &m11, &m02, &m30, &m21, &m12, &m03 }) {
+    column->clear();
+  }
+}
+
+void QuadTree::apply(std::vector<Planet>& planets) const {
+  parallelFor(leaves.size(), [&](size_t begin, size_t end) {
+    // Pool threads live on, their lists keep the capacity from earlier ticks.
+    // Coincident bodies at MAX_TREE_DEPTH can put any number of bodies in one leaf
+    static thread_local InteractionList list;
+    static thread_local std::vector<Vector2d> accelerations;
+
+    for (size_t i = begin; i < end; ++i) {
+      int32_t leaf = leaves[i];
+      Node const& node = nodes[leaf];
+
+      // Box around the group's bodies, tighter than the cell
+      Vector2d min = positions[order[node.first]];
+      Vector2d max = min;
+
+      for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+        Vector2d const& position = positions[order[j]];
+
+        min.x = fmin(min.x, position.x); min.y = fmin(min.y, position.y);
+        max.x = fmax(max.x, position.x); max.y = fmax(max.y, position.y);
+      }
+
+      Vector2d group_center = (min + max) / 2;
+
+      accelerations.resize(node.count);
+
+      buildInteractionList(leaf, group_center, list);
+      evaluateInteractionList(leaf, group_center, list, accelerations.data());
+
+      for (uint32_t j = 0; j < node.count; ++j) {
+        Planet& planet = planets[order[node.first + j]];
+        planet.punch(StateVector(accelerations[j] * double(planet.mass)));
+      }
+    }
+  });
+}
+
+void QuadTree::buildInteractionList(int32_t leaf, Vector2d group_center, InteractionList& list) const {
+  Node const& group = nodes[leaf];
+
+  list.clear();
+
+  Vector2d half_extent;
+
+  for (uint32_t i = group.first; i < group.first + group.count; ++i) {
+    Vector2d offset = separation(group_center, positions[order[i]]);
+
+    half_extent.x = fmax(half_extent.x, fabs(offset.x));
+    half_extent.y = fmax(half_extent.y, fabs(offset.y));
+  }
+
+  uint32_t node_count = static_cast<uint32_t>(nodes.size());
+
+  for (uint32_t index = 0; index < node_count;) {
+    Node const& node = nodes[index];
+
+    Vector2d to_mass = separation(group_center, node.mass_center);
+    Vector2d to_cell = separation(group_center, node.center);
+
+    // Cells overlapping the group are always opened
+    bool overlaps =
+      fabs(to_cell.x) <= node.half_size + half_extent.x &&
+      fabs(to_cell.y) <= node.half_size + half_extent.y;
+
+    if (!overlaps) {
+      // Accepted only if the criterion holds for the group's closest point
+      double gap_x = fmax(fabs(to_mass.x) - half_extent.x, 0.0);
+      double gap_y = fmax(fabs(to_mass.y) - half_extent.y, 0.0);
+      double distance = sqrt(gap_x * gap_x + gap_y * gap_y);
+
+      if (node.half_size * 2 < theta * distance) {
+        list.cell_x.push_back(static_cast<float>(to_mass.x));
+        list.cell_y.push_back(static_cast<float>(to_mass.y));
+
+        if (multipole_order > 1) {
+          double const* m = &multipoles[index * expansion.terms];
+
+          list.m00.push_back(static_cast<float>(G * m[Expansion::index(0, 0)]));
+          list.m20.push_back(static_cast<float>(G * m[Expansion::index(2, 0)]));
+          list.m11.push_back(static_cast<float>(G * m[Expansion::index(1, 1)]));
+          list.m02.push_back(static_cast<float>(G * m[Expansion::index(0, 2)]));
+
+          if (multipole_order > 2) {
+            list.m30.push_back(static_cast<float>(G * m[Expansion::index(3, 0)]));
+            list.m21.push_back(static_cast<float>(G * m[Expansion::index(2, 1)]));
+            list.m12.push_back(static_cast<float>(G * m[Expansion::index(1, 2)]));
+            list.m03.push_back(static_cast<float>(G * m[Expansion::index(0, 3)]));
+          }
+        }
+        else {
+          list.m00.push_back(static_cast<float>(G * node.mass));
+        }
+
+        index = node.next;
+        continue;
+      }
+    }
+
+    if (node.isLeaf()) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        uint32_t body = order[i];
+        Vector2d offset = separation(group_center, positions[body]);
+
+        list.x.push_back(static_cast<float>(offset.x));
+        list.y.push_back(static_cast<float>(offset.y));
+        list.gm.push_back(static_cast<float>(G * masses[body]));
+      }
+
+      index = node.next;
+      continue;
+    }
+
+    ++index;
+  }
+}
+
+// Cell part of the group kernel, Order picks how many moments enter
+template <uint32_t Order>
+static inline void cellKernel(QuadTree::InteractionList const& list, float bx, float by, float& ax, float& ay) {
+  size_t count = list.cell_x.size();
+
+  float const* __restrict cx = list.cell_x.data();
+  float const* __restrict cy = list.cell_y.data();
+  float const* __restrict m00 = list.m00.data();
+  float const* __restrict m20 = Order > 1 ? list.m20.data() : nullptr;
+  float const* __restrict m11 = Order > 1 ? list.m11.data() : nullptr;
+  float const* __restrict m02 = Order > 1 ? list.m02.data() : nullptr;
+  float const* __restrict m30 = Order > 2 ? list.m30.data() : nullptr;
+  float const* __restrict m21 = Order > 2 ? list.m21.data() : nullptr;
+  float const* __restrict m12 = Order > 2 ? list.m12.data() : nullptr;
+  float const* __restrict m03 = Order > 2 ? list.m03.data() : nullptr;
+
+  float sum_x = 0.0f, sum_y = 0.0f;
+
+  // Same expansion as QuadTree::multipoleAcceleration(), separation = body - cell
+  #pragma omp simd reduction(+:sum_x, sum_y)
+  for (size_t k = 0; k < count; ++k) {
+    float x = bx - cx[k], y = by - cy[k];
+    float x2 = x * x, y2 = y * y;
+
+    float inv_r2 = 1.0f / (x2 + y2);
+    float inv_r = sqrtf(inv_r2);
+    float inv_r3 = inv_r * inv_r2;
+
+    float gx = -x * inv_r3 * m00[k];
+    float gy = -y * inv_r3 * m00[k];
+
+    if (Order > 1) {
+      float inv_r5 = inv_r3 * inv_r2;
+      float inv_r7 = inv_r5 * inv_r2;
+
+      float d30 = -15 * x2 * x * inv_r7 + 9 * x * inv_r5;
+      float d21 = -15 * x2 * y * inv_r7 + 3 * y * inv_r5;
+      float d12 = -15 * x * y2 * inv_r7 + 3 * x * inv_r5;
+      float d03 = -15 * y2 * y * inv_r7 + 9 * y * inv_r5;
+
+      gx += m20[k] * d30 + m11[k] * d21 + m02[k] * d12;
+      gy += m20[k] * d21 + m11[k] * d12 + m02[k] * d03;
+
+      if (Order > 2) {
+        float inv_r9 = inv_r7 * inv_r2;
+        float xy = x * y;
+
+        float d40 = 105 * x2 * x2 * inv_r9 - 90 * x2 * inv_r7 + 9 * inv_r5;
+        float d31 = 105 * x2 * xy * inv_r9 - 45 * xy * inv_r7;
+        float d22 = 105 * x2 * y2 * inv_r9 - 15 * (x2 + y2) * inv_r7 + 3 * inv_r5;
+        float d13 = 105 * xy * y2 * inv_r9 - 45 * xy * inv_r7;
+        float d04 = 105 * y2 * y2 * inv_r9 - 90 * y2 * inv_r7 + 9 * inv_r5;
+
+        gx -= m30[k] * d40 + m21[k] * d31 + m12[k] * d22 + m03[k] * d13;
+        gy -= m30[k] * d31 + m21[k] * d22 + m12[k] * d13 + m03[k] * d04;
+      }
+    }
+
+    sum_x += gx;
+    sum_y += gy;
+  }
+
+  ax += sum_x;
+  ay += sum_y;
+}
+
+void QuadTree::evaluateInteractionList(int32_t leaf, Vector2d group_center, InteractionList const& list, Vector2d* accelerations) const {
+  Node const& group = nodes[leaf];
+
+  size_t count = list.x.size();
+
+  float const* __restrict px = list.x.data();
+  float const* __restrict py = list.y.data();
+  float const* __restrict gm = list.gm.data();
+
+  for (uint32_t i = 0; i < group.count; ++i) {
+    Vector2d offset = separation(group_center, positions[order[group.first + i]]);
+
+    float bx = static_cast<float>(offset.x);
+    float by = static_cast<float>(offset.y);
+
+    float ax = 0.0f, ay = 0.0f;
+
+    // The group's own bodies are in the list, zero distance masks them out
+    #pragma omp simd reduction(+:ax, ay)
+    for (size_t k = 0; k < count; ++k) {
+      float dx = px[k] - bx;
+      float dy = py[k] - by;
+
+      float distance2 = dx * dx + dy * dy;
+      bool self = distance2 == 0.0f;
+
+      float inv_distance = 1.0f / sqrtf(self ? 1.0f : distance2);
+      float factor = self ? 0.0f : gm[k] * inv_distance * inv_distance * inv_distance;
+
+      ax += dx * factor;
+      ay += dy * factor;
+    }
+
+    if (multipole_order > 2) {
+      cellKernel<3>(list, bx, by, ax, ay);
+    }
+    else if (multipole_order > 1) {
+      cellKernel<2>(list, bx, by, ax, ay);
+    }
+    else {
+      cellKernel<1>(list, bx, by, ax, ay);
+    }
+
+    accelerations[i] = Vector2d(ax, ay);
+  }
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include <type_traits>
+#include <vector>
+
+#include "Gravity.h"
+#include "Multipole.h"
+#include "Planet.h"
+
+// Barnes-Hut quadtree over a copy of the planet positions, rebuilt every tick.
+// Cells carry their mass and centre of mass, and with multipole_order 2 (quadrupole) or 3 (octupole)
+// also the higher moments about it, which let the walk accept cells at a larger theta.
+// Nodes live in one array in depth-first order: a node's first child is the next node and its
+// subtree ends at next, so walks only ever move forward. All arrays keep their capacity between
+// builds, radixSort()'s too, a tree of steady size is rebuilt without allocating
+class QuadTree {
+public:
+  struct Node {
+    Vector2d center;      // of the square cell
+    double   half_size;
+    Vector2d mass_center;
+    double   mass;
+    int32_t  children[4]; // -1 where the quadrant is empty
+    uint32_t first;       // bodies of the subtree are order[first, first + count)
+    uint32_t count;
+    uint32_t next;        // first node after the subtree
+    uint32_t depth;
+
+    inline bool isLeaf() const noexcept {
+      return children[0] < 0 && children[1] < 0 && children[2] < 0 && children[3] < 0;
+    }
+  };
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> scratch;
+
+  // Morton keys of order[i], the build splits the sorted keys instead of moving bodies
+  std::vector<uint64_t> keys, key_scratch;
+
+  // Subtrees below subtree_depth are built and summed up in parallel, each into its own
+  // stretch of nodes, the few top nodes above them serially
+  struct Subtree {
+    Vector2d center;
+    double   half_size;
+    uint32_t first, count, depth;
+    uint32_t index;      // of its root in nodes
+    uint32_t node_count;
+  };
+
+  std::vector<Subtree> subtrees;
+  std::vector<int32_t> top_nodes;
+  uint32_t subtree_depth = 1;
+
+  // update() keeps the topology and only refits cells while the summed leaf extent stays
+  // below refit_tolerance times what it was after the last build, 0 rebuilds every time
+  double   refit_tolerance = 1.3;
+  double   built_extent = 0.0;
+  double   root_half_size = 0.0;
+  uint32_t built_body_count = 0;
+
+  std::vector<Vector2d> positions;
+  std::vector<double> masses;
+
+  double   theta = 0.5;    // opening angle
+  uint32_t leaf_size = 8;
+  double   box_size = 0.0; // side of the periodic box, 0 for open space
+
+  uint32_t multipole_order;
+  Expansion expansion;
+  std::vector<double> multipoles; // expansion.terms per node, empty for monopole trees
+
+  std::vector<int32_t> leaves;
+
+  // What one leaf group sees: bodies of opened leaves and accepted cells, positions relative
+  // to the group centre, structure of arrays in float so the kernels vectorise
+  struct InteractionList {
+    std::vector<float> x, y, gm;               // bodies, G * mass
+    std::vector<float> cell_x, cell_y;         // cells, G * moments
+    std::vector<float> m00, m20, m11, m02;
+    std::vector<float> m30, m21, m12, m03;
+
+    void clear();
+  };
+
+public:
+  QuadTree(uint32_t multipole_order = 1, double theta = 0.5);
+
+public:
+  void build(std::vector<Planet> const& planets);
+
+  // Refits cell bounds and moments around the moved bodies, or rebuilds when the tree got
+  // too loose. Bodies are matched by index, invalidate() after planets were reordered
+  void update(std::vector<Planet> const& planets);
+  void invalidate();
+
+  // Punches every planet with the Newtonian tree force. Walks once per leaf for all of
+  // its bodies, then evaluates the shared interaction list with SIMD kernels
+  void apply(std::vector<Planet>& planets) const;
+
+  void buildInteractionList(int32_t leaf, Vector2d group_center, InteractionList& list) const;
+  void evaluateInteractionList(int32_t leaf, Vector2d group_center, InteractionList const& list, Vector2d* accelerations) const;
+
+  // Acceleration of a body, kernel(r) scales the Newtonian force at distance r.
+  // Cells and bodies farther than cutoff are skipped
+  template <typename Kernel>
+  Vector2d acceleration(uint32_t body, Kernel const& kernel, double cutoff = INFINITY) const;
+
+  // from -> to, nearest periodic image when box_size is set
+  inline Vector2d separation(Vector2d from, Vector2d to) const noexcept {
+    Vector2d diff = to - from;
+
+    if (box_size > 0.0) {
+      diff.x -= box_size * floor(diff.x / box_size + 0.5);
+      diff.y -= box_size * floor(diff.y / box_size + 0.5);
+    }
+
+    return diff;
+  }
+
+  // Quadrupole and octupole terms written out, the generic Expansion is several times slower.
+  // separation = body - centre of mass, the dipole vanishes about it
+  inline Vector2d multipoleAcceleration(int32_t index, Vector2d separation) const noexcept {
+    double const* m = &multipoles[index * expansion.terms];
+
+    double x = separation.x, y = separation.y;
+    double x2 = x * x, y2 = y * y, xy = x * y;
+
+    double inv_r2 = 1.0 / (x2 + y2);
+    double inv_r = sqrt(inv_r2);
+    double inv_r3 = inv_r * inv_r2;
+    double inv_r5 = inv_r3 * inv_r2;
+    double inv_r7 = inv_r5 * inv_r2;
+
+    // Derivatives of 1 / r, D_ab = d^a/dx^a d^b/dy^b
+    double d10 = -x * inv_r3, d01 = -y * inv_r3;
+
+    double d30 = -15 * x2 * x * inv_r7 + 9 * x * inv_r5;
+    double d21 = -15 * x2 * y * inv_r7 + 3 * y * inv_r5;
+    double d12 = -15 * x * y2 * inv_r7 + 3 * x * inv_r5;
+    double d03 = -15 * y2 * y * inv_r7 + 9 * y * inv_r5;
+
+    double m00 = m[Expansion::index(0, 0)];
+    double m20 = m[Expansion::index(2, 0)], m11 = m[Expansion::index(1, 1)], m02 = m[Expansion::index(0, 2)];
+
+    Vector2d sum(
+      m00 * d10 + m20 * d30 + m11 * d21 + m02 * d12,
+      m00 * d01 + m20 * d21 + m11 * d12 + m02 * d03
+    );
+
+    if (multipole_order > 2) {
+      double inv_r9 = inv_r7 * inv_r2;
+
+      double d40 = 105 * x2 * x2 * inv_r9 - 90 * x2 * inv_r7 + 9 * inv_r5;
+      double d31 = 105 * x2 * xy * inv_r9 - 45 * xy * inv_r7;
+      double d22 = 105 * x2 * y2 * inv_r9 - 15 * (x2 + y2) * inv_r7 + 3 * inv_r5;
+      double d13 = 105 * xy * y2 * inv_r9 - 45 * xy * inv_r7;
+      double d04 = 105 * y2 * y2 * inv_r9 - 90 * y2 * inv_r7 + 9 * inv_r5;
+
+      double m30 = m[Expansion::index(3, 0)], m21 = m[Expansion::index(2, 1)];
+      double m12 = m[Expansion::index(1, 2)], m03 = m[Expansion::index(0, 3)];
+
+      // Odd order terms enter with a minus sign
+      sum.x -= m30 * d40 + m21 * d31 + m12 * d22 + m03 * d13;
+      sum.y -= m30 * d31 + m21 * d22 + m12 * d13 + m03 * d04;
+    }
+
+    return sum * G;
+  }
+
+private:
+  void splitRange(uint32_t first, uint32_t count, uint32_t depth, uint32_t* starts) const;
+  uint32_t countNodes(uint32_t first, uint32_t count, uint32_t depth) const;
+  uint32_t collectSubtrees(Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth);
+
+  void initNode(int32_t index, Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth);
+  int32_t buildTop(uint32_t& cursor, uint32_t& next_subtree, Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth);
+  int32_t buildNode(uint32_t& cursor, Vector2d center, double half_size, uint32_t first, uint32_t count, uint32_t depth);
+
+  // Calls fn for every node, children before parents, subtrees in parallel
+  template <typename F>
+  void bottomUp(F const& fn);
+
+  void refitBounds(int32_t index);
+  void computeMoments(int32_t index);
+  void computeMultipoles(int32_t index);
+
+  // Sum of the leaves' body extents, how loose the tree is
+  double leafExtent() const;
+};
+
+struct NewtonianKernel {
+  inline double operator()(double) const noexcept {
+    return 1.0;
+  }
+};
+
+template <typename Kernel>
+Vector2d QuadTree::acceleration(uint32_t body, Kernel const& kernel, double cutoff) const {
+  Vector2d position = positions[body];
+  Vector2d result;
+
+  uint32_t node_count = static_cast<uint32_t>(nodes.size());
+
+  for (uint32_t index = 0; index < node_count;) {
+    Node const& node = nodes[index];
+
+    Vector2d to_cell = separation(position, node.center);
+
+    // Closest point of the cell is out of range
+    double gap_x = fabs(to_cell.x) - node.half_size;
+    double gap_y = fabs(to_cell.y) - node.half_size;
+
+    if (gap_x > 0.0 || gap_y > 0.0) {
+      gap_x = gap_x > 0.0 ? gap_x : 0.0;
+      gap_y = gap_y > 0.0 ? gap_y : 0.0;
+
+      if (gap_x * gap_x + gap_y * gap_y > cutoff * cutoff) {
+        index = node.next;
+        continue;
+      }
+    }
+
+    if (node.isLeaf()) {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        uint32_t other = order[i];
+
+        if (other == body) {
+          continue;
+        }
+
+        Vector2d diff = separation(position, positions[other]);
+        double distance = diff.length();
+
+        if (distance > 0.0 && distance <= cutoff) {
+          result += diff * (G * masses[other] * kernel(distance) / (distance * distance * distance));
+        }
+      }
+
+      index = node.next;
+      continue;
+    }
+
+    Vector2d diff = separation(position, node.mass_center);
+    double distance = diff.length();
+
+    // The body's own cell is never approximated, whatever theta is
+    bool inside = gap_x <= 0.0 && gap_y <= 0.0;
+
+    if (!inside && node.half_size * 2 < theta * distance) {
+      if (distance <= cutoff) {
+        // Higher moments only make sense for the plain Newtonian kernel
+        if (std::is_same<Kernel, NewtonianKernel>::value && multipole_order > 1) {
+          result += multipoleAcceleration(static_cast<int32_t>(index), -diff);
+        }
+        else {
+          result += diff * (G * node.mass * kernel(distance) / (distance * distance * distance));
+        }
+      }
+
+      index = node.next;
+      continue;
+    }
+
+    // Opened, first child follows
+    ++index;
+  }
+
+  return result;
+}
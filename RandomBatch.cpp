@@ -0,0 +1,79 @@
+#include "RandomBatch.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+#include "Morton.h"
+#include "Parallel.h"
+
+RandomBatch::RandomBatch(uint32_t batch_size, uint64_t seed) {
+  this->batch_size = batch_size < 2 ? 2 : batch_size;
+  this->seed = seed;
+}
+
+// SplitMix64 finaliser, a counter-based generator: no state to share between threads
+static inline uint64_t mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+void RandomBatch::apply(std::vector<Planet>& planets) {
+  keys.clear();
+  order.clear();
+
+  uint64_t stream = mix(seed ^ mix(tick++ + 0x9E3779B97F4A7C15ull));
+
+  for (size_t i = 0; i < planets.size(); ++i) {
+    // Tracers pull nothing and get their pull from TracerGravity
+    if (planets[i].isTracer()) {
+      continue;
+    }
+
+    keys.push_back(mix(stream + i));
+    order.push_back(static_cast<uint32_t>(i));
+  }
+
+  size_t count = order.size();
+
+  if (count < 2) {
+    return;
+  }
+
+  radixSort(keys, order, key_scratch, order_scratch);
+
+  // Batch sizes differ by at most one and none is smaller than batch_size (or count)
+  size_t batch_count = count / batch_size;
+  batch_count = batch_count ? batch_count : 1;
+
+  parallelFor(batch_count, [&](size_t begin, size_t end) {
+    for (size_t batch = begin; batch < end; ++batch) {
+      size_t first = batch * count / batch_count;
+      size_t last = (batch + 1) * count / batch_count;
+
+      // Unbiased: any other planet shares the batch with probability (size - 1) / (count - 1)
+      double scale = double(count - 1) / double(last - first - 1);
+
+      for (size_t a = first; a < last; ++a) {
+        Planet& first_planet = planets[order[a]];
+
+        for (size_t b = a + 1; b < last; ++b) {
+          Planet& second_planet = planets[order[b]];
+
+          Vector2d diff = Vector2d(second_planet.position) - Vector2d(first_planet.position);
+          double distance2 = diff.x * diff.x + diff.y * diff.y;
+
+          // Coincident planets have no direction to pull in
+          if (distance2 == 0.0) {
+            continue;
+          }
+
+          double force = scale * G * double(first_planet.mass) * double(second_planet.mass) / (distance2 * sqrt(distance2));
+
+          first_planet.punch(StateVector(diff * force));
+          second_planet.punch(StateVector(-diff * force));
+        }
+      }
+    }
+  });
+}
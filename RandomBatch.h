@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Planet.h"
+
+// Random batch method (Jin, Li & Liu 2020). Every tick the massive planets are shuffled into
+// batches of batch_size or a little more, and each planet only feels the others in its batch,
+// scaled by (n - 1) / (batch - 1) so the expected force is the exact one. n * batch_size work
+// per tick, the error is noise that averages out over ticks rather than a bias.
+// The shuffle sorts by a hash of (seed, tick, slot), the same for any thread count
+class RandomBatch {
+public:
+  uint32_t batch_size;
+  uint64_t seed;
+  uint64_t tick = 0;
+
+  std::vector<uint64_t> keys, key_scratch;
+  std::vector<uint32_t> order, order_scratch; // slots of massive planets, shuffled
+
+public:
+  RandomBatch(uint32_t batch_size = 4, uint64_t seed = 1);
+
+public:
+  void apply(std::vector<Planet>& planets);
+};
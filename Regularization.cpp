@@ -0,0 +1,225 @@
+#include "Regularization.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <complex>
+
+#include "Gravity.h"
+#include "Morton.h"
+
+#define REGULARIZATION_STEPS ( 128 ) // RK4 steps per orbit in fictitious time
+#define REGULARIZATION_MAX_STEPS ( 1 << 20 )
+
+using Complex = std::complex<double>;
+
+static constexpr double PI = 3.14159265358979323846;
+
+PairRegularization::PairRegularization(double close_radius) {
+  this->close_radius = close_radius;
+}
+
+void PairRegularization::begin(std::vector<Planet> const& planets) {
+  size_t count = planets.size();
+
+  pairs.clear();
+  candidates.clear();
+
+  if (count < 2) {
+    return;
+  }
+
+  keys.resize(count);
+  indices.resize(count);
+
+  // Cells shifted to positive coordinates, anything beyond 2^31 cells shares the edge ones
+  auto cellOf = [&](double coordinate) {
+    double cell = floor(coordinate / close_radius) + 2147483648.0;
+    return static_cast<uint32_t>(fmin(fmax(cell, 0.0), 4294967295.0));
+  };
+
+  for (size_t i = 0; i < count; ++i) {
+    Vector2d position = Vector2d(planets[i].position);
+
+    keys[i] = mortonKey(cellOf(position.x), cellOf(position.y));
+    indices[i] = static_cast<uint32_t>(i);
+  }
+
+  radixSort(keys, indices, key_scratch, index_scratch);
+
+  for (size_t k = 0; k < count; ++k) {
+    uint32_t i = indices[k];
+    Planet const& planet = planets[i];
+
+    if (planet.isTracer()) {
+      continue;
+    }
+
+    Vector2d position = Vector2d(planet.position);
+    uint32_t cell_x = cellOf(position.x), cell_y = cellOf(position.y);
+
+    for (int32_t dy = -1; dy <= 1; ++dy) {
+      for (int32_t dx = -1; dx <= 1; ++dx) {
+        uint64_t key = mortonKey(cell_x + dx, cell_y + dy);
+        auto range = std::equal_range(keys.begin(), keys.end(), key);
+
+        for (auto it = range.first; it != range.second; ++it) {
+          uint32_t j = indices[it - keys.begin()];
+          Planet const& other = planets[j];
+
+          // Every pair once
+          if (j <= i || other.isTracer()) {
+            continue;
+          }
+
+          Vector2d z = Vector2d(other.position) - position;
+          double distance = z.length();
+
+          if (distance == 0.0 || distance >= close_radius) {
+            continue;
+          }
+
+          Vector2d v = Vector2d(other.velocity) / double(other.mass) - Vector2d(planet.velocity) / double(planet.mass);
+          double mu = G * (double(planet.mass) + double(other.mass));
+
+          // Only bound pairs stay together long enough to be worth it
+          if ((v.x * v.x + v.y * v.y) / 2 - mu / distance >= 0.0) {
+            continue;
+          }
+
+          candidates.push_back({ i, j, distance });
+        }
+      }
+    }
+  }
+
+  // Closest pairs first, every planet in one pair at most
+  std::sort(candidates.begin(), candidates.end(), [](Candidate const& a, Candidate const& b) {
+    return a.distance < b.distance;
+  });
+
+  paired.assign(count, false);
+
+  for (Candidate const& candidate : candidates) {
+    if (paired[candidate.first] || paired[candidate.second]) {
+      continue;
+    }
+
+    paired[candidate.first] = paired[candidate.second] = true;
+
+    pairs.push_back({ candidate.first, candidate.second, { planets[candidate.first], planets[candidate.second] } });
+  }
+}
+
+void PairRegularization::end(std::vector<Planet>& planets, PairKick const& pair_kick) {
+  for (Pair const& pair : pairs) {
+    Planet& first = planets[pair.first];
+    Planet& second = planets[pair.second];
+
+    double m1 = first.mass, m2 = second.mass;
+    double total_mass = m1 + m2;
+
+    Vector2d positions[2] = { Vector2d(pair.start[0].position), Vector2d(pair.start[1].position) };
+    Vector2d momenta[2] = { Vector2d(pair.start[0].velocity), Vector2d(pair.start[1].velocity) };
+
+    // The pair's own pull, computed again by the same kernel from the same start state
+    Planet pulled[2] = { pair.start[0], pair.start[1] };
+    pair_kick(pulled[0], pulled[1]);
+
+    // Kicks of this tick less that pull, what's left came from everything else
+    Vector2d kick1 = Vector2d(first.velocity - pulled[0].velocity);
+    Vector2d kick2 = Vector2d(second.velocity - pulled[1].velocity);
+
+    // Centre of mass: kick then drift like every other planet
+    Vector2d center = (positions[0] * m1 + positions[1] * m2) / total_mass;
+    Vector2d momentum = momenta[0] + momenta[1] + kick1 + kick2;
+
+    center += momentum / total_mass;
+
+    // Relative orbit under the difference of the external pulls
+    Vector2d z = positions[1] - positions[0];
+    Vector2d v = momenta[1] / m2 - momenta[0] / m1;
+    Vector2d perturbation = kick2 / m2 - kick1 / m1;
+
+    regularizedDrift(G * total_mass, z, v, perturbation, 1.0);
+
+    first.position = PositionVector(center - z * (m2 / total_mass));
+    second.position = PositionVector(center + z * (m1 / total_mass));
+
+    Vector2d velocity = momentum / total_mass;
+
+    first.velocity = StateVector((velocity - v * (m2 / total_mass)) * m1);
+    second.velocity = StateVector((velocity + v * (m1 / total_mass)) * m2);
+  }
+}
+
+// u = sqrt(z), u' = du / dtau, h = energy per unit reduced mass, t = physical time
+struct RegularizedState {
+  Complex u, du;
+  double h, t;
+};
+
+static RegularizedState derivative(RegularizedState const& state, Complex perturbation) {
+  Complex conj_u = std::conj(state.u);
+  double r = std::norm(state.u);
+
+  RegularizedState rate;
+  rate.u = state.du;
+  rate.du = state.u * (state.h / 2) + conj_u * perturbation * (r / 2);
+  rate.h = 2 * std::real(std::conj(state.du) * perturbation * conj_u);
+  rate.t = r;
+
+  return rate;
+}
+
+static RegularizedState advance(RegularizedState const& state, RegularizedState const& rate, double step) {
+  return { state.u + rate.u * step, state.du + rate.du * step, state.h + rate.h * step, state.t + rate.t * step };
+}
+
+void regularizedDrift(double mu, Vector2d& z, Vector2d& v, Vector2d perturbation, double dt) {
+  Complex zc(z.x, z.y), vc(v.x, v.y), p(perturbation.x, perturbation.y);
+
+  double r = std::abs(zc);
+
+  if (r == 0.0) {
+    return;
+  }
+
+  RegularizedState state;
+  state.u = std::sqrt(zc);
+  state.du = vc * std::conj(state.u) / 2.0;
+  state.h = std::norm(vc) / 2 - mu / r;
+  state.t = 0.0;
+
+  // u oscillates at sqrt(-h / 2), one orbit of z is half an oscillation
+  double omega = sqrt(fmax(-state.h / 2, mu / (8 * r)));
+  double dtau = PI / (omega * REGULARIZATION_STEPS);
+
+  for (uint32_t i = 0; i < REGULARIZATION_MAX_STEPS; ++i) {
+    double remaining = dt - state.t;
+
+    if (fabs(remaining) <= 1e-13 * dt) {
+      break;
+    }
+
+    // Close to the end, dt = r dtau lands on it in a few refinements
+    double radius = std::norm(state.u);
+    double step = radius * dtau >= fabs(remaining) ? remaining / radius : dtau;
+
+    RegularizedState k1 = derivative(state, p);
+    RegularizedState k2 = derivative(advance(state, k1, step / 2), p);
+    RegularizedState k3 = derivative(advance(state, k2, step / 2), p);
+    RegularizedState k4 = derivative(advance(state, k3, step), p);
+
+    state.u += (k1.u + k2.u * 2.0 + k3.u * 2.0 + k4.u) * (step / 6);
+    state.du += (k1.du + k2.du * 2.0 + k3.du * 2.0 + k4.du) * (step / 6);
+    state.h += (k1.h + 2 * k2.h + 2 * k3.h + k4.h) * (step / 6);
+    state.t += (k1.t + 2 * k2.t + 2 * k3.t + k4.t) * (step / 6);
+  }
+
+  Complex new_z = state.u * state.u;
+  Complex new_v = 2.0 * state.du * state.u / std::norm(state.u);
+
+  z = Vector2d(new_z.real(), new_z.imag());
+  v = Vector2d(new_v.real(), new_v.imag());
+}
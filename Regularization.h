@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "Planet.h"
+
+// Levi-Civita regularisation of close bound pairs (Stiefel & Scheifele 1971). The relative
+// position z = u^2 is integrated in fictitious time dt = r dtau, where the Kepler problem becomes
+// a harmonic oscillator without the 1 / r^2 singularity. Pair members still go through the
+// global force calculation: their mutual pull is taken out again, the rest moves the centre of
+// mass and perturbs the regularised orbit. The pull taken out is the one the solver's own pair
+// kernel gives, so only an exact pairwise solver fits: anything approximating the pair's pull
+// would leave the approximation error behind as a perturbation
+class PairRegularization {
+public:
+  using PairKick = std::function<void(Planet& first, Planet& second)>; // the solver's pair kernel, punches both
+
+  struct Pair {
+    uint32_t first, second;
+    Planet   start[2]; // at the start of the tick
+  };
+
+  std::vector<Pair> pairs;
+
+  double close_radius; // pixels, bound pairs closer than this are regularised
+
+  // Neighbour search on a grid of close_radius cells
+  std::vector<uint64_t> keys, key_scratch;
+  std::vector<uint32_t> indices, index_scratch;
+
+  struct Candidate {
+    uint32_t first, second;
+    double   distance;
+  };
+
+  std::vector<Candidate> candidates;
+  std::vector<bool> paired;
+
+public:
+  PairRegularization(double close_radius = 20.0);
+
+public:
+  // Finds the pairs and remembers their state, call before the tick's kicks
+  void begin(std::vector<Planet> const& planets);
+
+  // Replaces the pair members' kick-drift tick by the regularised one
+  void end(std::vector<Planet>& planets, PairKick const& pair_kick);
+};
+
+// Advances the relative motion z, v of a pair with gravitational parameter mu by dt under
+// the constant perturbing acceleration perturbation
+void regularizedDrift(double mu, Vector2d& z, Vector2d& v, Vector2d perturbation, double dt);
@@ -0,0 +1,157 @@
+#include "Respa.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Gravity.h"
+#include "Morton.h"
+#include "Parallel.h"
+
+RespaIntegrator::RespaIntegrator(uint32_t inner_steps, double cutoff_radius) {
+  this->inner_steps = inner_steps;
+  this->cutoff_radius = cutoff_radius;
+  this->inner_radius = cutoff_radius / 2;
+}
+
+// Cells shifted to positive coordinates, anything beyond 2^31 cells shares the edge ones
+static inline uint32_t gridCell(double coordinate, double cell_size) {
+  double cell = floor(coordinate / cell_size) + 2147483648.0;
+  return static_cast<uint32_t>(fmin(fmax(cell, 0.0), 4294967295.0));
+}
+
+void RespaIntegrator::step(std::vector<Planet>& planets, ForceCallback const& full_force) {
+  size_t count = planets.size();
+
+  if (long_forces.size() != count || short_forces.size() != count) {
+    forces_valid = false;
+  }
+
+  if (!forces_valid) {
+    computeShortForces(planets);
+    computeLongForces(planets, full_force);
+  }
+
+  double h = 1.0 / inner_steps;
+
+  kick(planets, long_forces, 0.5);
+
+  // Short range forces are evaluated once per drift, each serves two half kicks
+  for (uint32_t i = 0; i < inner_steps; ++i) {
+    kick(planets, short_forces, h / 2);
+
+    drift(planets, h);
+
+    computeShortForces(planets);
+    kick(planets, short_forces, h / 2);
+  }
+
+  // Positions of the next tick's first half kicks too
+  computeLongForces(planets, full_force);
+  kick(planets, long_forces, 0.5);
+}
+
+void RespaIntegrator::invalidate() {
+  forces_valid = false;
+}
+
+void RespaIntegrator::computeShortForces(std::vector<Planet> const& planets) {
+  size_t count = planets.size();
+
+  short_forces.resize(count);
+  keys.resize(count);
+  indices.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    Vector2d position = Vector2d(planets[i].position);
+
+    keys[i] = mortonKey(gridCell(position.x, cutoff_radius), gridCell(position.y, cutoff_radius));
+    indices[i] = static_cast<uint32_t>(i);
+  }
+
+  radixSort(keys, indices, key_scratch, index_scratch);
+
+  double width = cutoff_radius - inner_radius;
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Planet const& planet = planets[i];
+      Vector2d position = Vector2d(planet.position);
+
+      uint32_t cell_x = gridCell(position.x, cutoff_radius);
+      uint32_t cell_y = gridCell(position.y, cutoff_radius);
+
+      Vector2d acceleration;
+
+      for (int32_t dy = -1; dy <= 1; ++dy) {
+        for (int32_t dx = -1; dx <= 1; ++dx) {
+          auto range = std::equal_range(keys.begin(), keys.end(), mortonKey(cell_x + dx, cell_y + dy));
+
+          for (auto it = range.first; it != range.second; ++it) {
+            uint32_t j = indices[it - keys.begin()];
+
+            if (j == i || planets[j].isTracer()) {
+              continue;
+            }
+
+            Vector2d diff = Vector2d(planets[j].position) - position;
+            double distance = diff.length();
+
+            if (distance == 0.0 || distance >= cutoff_radius) {
+              continue;
+            }
+
+            // -d/dr of -S(r) / r, S = 1 - x^2 (3 - 2x) across the switching shell
+            double magnitude = 1.0 / (distance * distance);
+
+            if (distance > inner_radius) {
+              double x = (distance - inner_radius) / width;
+              double s = 1.0 - x * x * (3.0 - 2.0 * x);
+              double ds = -6.0 * x * (1.0 - x) / width;
+
+              magnitude = s / (distance * distance) - ds / distance;
+            }
+
+            acceleration += diff * (G * planets[j].mass * magnitude / distance);
+          }
+        }
+      }
+
+      // Tracers take accelerations as their punches
+      short_forces[i] = planet.isTracer() ? acceleration : acceleration * double(planet.mass);
+    }
+  });
+}
+
+void RespaIntegrator::computeLongForces(std::vector<Planet>& planets, ForceCallback const& full_force) {
+  size_t count = planets.size();
+
+  momenta.resize(count);
+  long_forces.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    momenta[i] = Vector2d(planets[i].velocity);
+  }
+
+  full_force();
+
+  for (size_t i = 0; i < count; ++i) {
+    long_forces[i] = Vector2d(planets[i].velocity) - momenta[i] - short_forces[i];
+    planets[i].velocity = StateVector(momenta[i]);
+  }
+
+  forces_valid = true;
+}
+
+void RespaIntegrator::kick(std::vector<Planet>& planets, std::vector<Vector2d> const& forces, double dt) const {
+  for (size_t i = 0; i < planets.size(); ++i) {
+    planets[i].punch(StateVector(forces[i] * dt));
+  }
+}
+
+void RespaIntegrator::drift(std::vector<Planet>& planets, double dt) const {
+  for (Planet& planet : planets) {
+    Vector2d velocity = planet.isTracer() ? Vector2d(planet.velocity) : Vector2d(planet.velocity) / double(planet.mass);
+    planet.move(StateVector(velocity * dt));
+  }
+}
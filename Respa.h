@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "Planet.h"
+
+// RESPA multiple time stepping (Tuckerman, Berne & Martyna 1992). The pair potential is split
+// with a smooth switch S(r), 1 inside inner_radius and 0 past cutoff_radius, into a short range
+// part -G m S(r) / r and the long range rest. The short range forces come from a neighbour grid
+// every inner step, the long range ones once per tick as the full solver force less the short
+// part. Both parts are conservative, so the nested kick-drift-kick stays symplectic:
+// long(1/2), [short(h/2), drift(h), short(h/2)] * inner_steps, long(1/2)
+class RespaIntegrator {
+public:
+  using ForceCallback = std::function<void()>; // punches every planet with one tick of the full force
+
+  uint32_t inner_steps;
+  double   cutoff_radius;
+  double   inner_radius;
+
+  std::vector<Vector2d> short_forces;
+  std::vector<Vector2d> long_forces;
+  std::vector<Vector2d> momenta;
+
+  bool forces_valid = false; // both refer to the current positions
+
+  // Neighbour search on a grid of cutoff_radius cells
+  std::vector<uint64_t> keys, key_scratch;
+  std::vector<uint32_t> indices, index_scratch;
+
+public:
+  RespaIntegrator(uint32_t inner_steps = 8, double cutoff_radius = 50.0);
+
+public:
+  void step(std::vector<Planet>& planets, ForceCallback const& full_force);
+
+  // Cached forces refer to planets by slot
+  void invalidate();
+
+private:
+  void computeShortForces(std::vector<Planet> const& planets);
+
+  // Full solver force less short_forces, which must be current
+  void computeLongForces(std::vector<Planet>& planets, ForceCallback const& full_force);
+
+  void kick(std::vector<Planet>& planets, std::vector<Vector2d> const& forces, double dt) const;
+  void drift(std::vector<Planet>& planets, double dt) const;
+};
@@ -0,0 +1,41 @@
+#include "SmallSystem.h"
+
+#if SIMULATION_PRECISION != PRECISION_DOUBLE_FLOAT
+
+template <size_t N>
+static void tickSmallSystem(std::vector<Planet>& planets) {
+  SmallSystem<N> system;
+
+  system.load(planets);
+  system.tick();
+  system.store(planets);
+}
+
+bool smallSystemTick(std::vector<Planet>& planets) {
+  for (Planet const& planet : planets) {
+    if (planet.isTracer()) {
+      return false;
+    }
+  }
+
+  switch (planets.size()) {
+  case 2:  tickSmallSystem<2>(planets);  return true;
+  case 3:  tickSmallSystem<3>(planets);  return true;
+  case 4:  tickSmallSystem<4>(planets);  return true;
+  case 5:  tickSmallSystem<5>(planets);  return true;
+  case 6:  tickSmallSystem<6>(planets);  return true;
+  case 7:  tickSmallSystem<7>(planets);  return true;
+  case 8:  tickSmallSystem<8>(planets);  return true;
+  case 9:  tickSmallSystem<9>(planets);  return true;
+  case 10: tickSmallSystem<10>(planets); return true;
+  case 11: tickSmallSystem<11>(planets); return true;
+  case 12: tickSmallSystem<12>(planets); return true;
+  case 13: tickSmallSystem<13>(planets); return true;
+  case 14: tickSmallSystem<14>(planets); return true;
+  case 15: tickSmallSystem<15>(planets); return true;
+  case 16: tickSmallSystem<16>(planets); return true;
+  default: return false;
+  }
+}
+
+#endif
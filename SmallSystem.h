@@ -0,0 +1,118 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "Gravity.h"
+#include "Planet.h"
+
+#define SMALL_SYSTEM_MAX ( 16 ) // Largest planet count with its own kernel
+
+// Double-float positions go through DoubleFloatGravity instead
+#if SIMULATION_PRECISION != PRECISION_DOUBLE_FLOAT
+
+// Calls fn.template step<K>() for K in [Begin, End), unrolled at compile time
+template <size_t Begin, size_t End>
+struct Unroll {
+  template <typename F>
+  static inline void run(F& fn) {
+    fn.template step<Begin>();
+    Unroll<Begin + 1, End>::run(fn);
+  }
+};
+
+template <size_t End>
+struct Unroll<End, End> {
+  template <typename F>
+  static inline void run(F&) {}
+};
+
+// Pair K of n planets in the i < j order of the generic loops
+constexpr size_t pairFirst(size_t k, size_t n, size_t i = 0) {
+  return k < n - 1 - i ? i : pairFirst(k - (n - 1 - i), n, i + 1);
+}
+
+constexpr size_t pairSecond(size_t k, size_t n, size_t i = 0) {
+  return k < n - 1 - i ? i + 1 + k : pairSecond(k - (n - 1 - i), n, i + 1);
+}
+
+// Planets of a system with N known at compile time, in local arrays only ever indexed by
+// constants, so the compiler keeps them in registers. One tick is the same kick then drift,
+// in the same order and precision, as gravityTick() with SOLVER_PAIRWISE and Planet::tick()
+template <size_t N>
+class SmallSystem {
+public:
+  StateScalar x[N], y[N];
+  StateScalar px[N], py[N]; // momenta, like Planet::velocity
+  StateScalar mass[N];
+
+public:
+  void load(std::vector<Planet> const& planets) {
+    for (size_t i = 0; i < N; ++i) {
+      x[i] = planets[i].position.x;
+      y[i] = planets[i].position.y;
+      px[i] = planets[i].velocity.x;
+      py[i] = planets[i].velocity.y;
+      mass[i] = planets[i].mass;
+    }
+  }
+
+  void store(std::vector<Planet>& planets) const {
+    for (size_t i = 0; i < N; ++i) {
+      planets[i].position = PositionVector(x[i], y[i]);
+      planets[i].velocity = StateVector(px[i], py[i]);
+    }
+  }
+
+  template <size_t K>
+  inline void step() {
+    constexpr size_t I = pairFirst(K, N);
+    constexpr size_t J = pairSecond(K, N);
+
+    ForceScalar dx = ForceScalar(x[J] - x[I]);
+    ForceScalar dy = ForceScalar(y[J] - y[I]);
+
+    ForceScalar distance = sqrt(dx * dx + dy * dy);
+
+    // Coincident planets have no direction to pull in
+    if (distance == ForceScalar(0)) {
+      return;
+    }
+
+    ForceScalar force = ( ForceScalar(G) * ForceScalar(mass[I]) * ForceScalar(mass[J]) ) / ( distance * distance );
+
+    ForceScalar fx = dx / distance * force;
+    ForceScalar fy = dy / distance * force;
+
+    px[I] += StateScalar(fx);
+    py[I] += StateScalar(fy);
+    px[J] += StateScalar(-fx);
+    py[J] += StateScalar(-fy);
+  }
+
+  inline void kick() {
+    Unroll<0, N * (N - 1) / 2>::run(*this);
+  }
+
+  inline void drift() {
+    for (size_t i = 0; i < N; ++i) {
+      x[i] += px[i] / mass[i];
+      y[i] += py[i] / mass[i];
+    }
+  }
+
+  inline void tick(size_t ticks = 1) {
+    for (size_t t = 0; t < ticks; ++t) {
+      kick();
+      drift();
+    }
+  }
+};
+
+// Ticks planets with the SmallSystem kernel of their count. False, and planets untouched,
+// when there are more than SMALL_SYSTEM_MAX of them or any is a tracer
+bool smallSystemTick(std::vector<Planet>& planets);
+
+#endif
@@ -0,0 +1,315 @@
+#include "Sweep.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <new>
+
+#include "Parallel.h"
+
+#define SWEEP_NO_JOB ( 0xFFFFFFFFu )
+#define SWEEP_TABLE_VERSION ( 1 )
+
+// SweepRunner::owners, other values are slots
+#define SWEEP_UNCLAIMED ( 0xFFFFFFFFu )
+#define SWEEP_RELEASED  ( 0xFFFFFFFEu ) // finished or given up
+
+static int64_t monotonicNanoseconds() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+SweepRunner::SweepRunner(uint32_t worker_count, uint32_t max_attempts, double job_timeout, uint32_t batch_size) {
+  this->worker_count = worker_count;
+  this->max_attempts = max_attempts < 1 ? 1 : max_attempts;
+  this->job_timeout = job_timeout;
+  this->batch_size = batch_size < 1 ? 1 : batch_size;
+}
+
+bool SweepRunner::run(uint32_t row_count, char const* table_path, Job const& job) {
+  uint32_t job_count = uint32_t((uint64_t(row_count) + batch_size - 1) / batch_size);
+
+  // Creates the thread pool here whatever the worker count, so children inherit it instead of
+  // each starting their own threads the first time they call parallelFor()
+  size_t threads = threadCount();
+  size_t count = worker_count ? worker_count : threads;
+
+  int file = open(table_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (file < 0) {
+    fprintf(stderr, "Failed to open sweep table %s: %s\n", table_path, strerror(errno));
+    return false;
+  }
+
+  size_t table_size = sizeof(SweepTableHeader) + size_t(row_count) * sizeof(SweepResult);
+
+  if (ftruncate(file, off_t(table_size)) != 0) {
+    fprintf(stderr, "Failed to size sweep table %s: %s\n", table_path, strerror(errno));
+    close(file);
+    return false;
+  }
+
+  void* table = mmap(nullptr, table_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  close(file);
+
+  if (table == MAP_FAILED) {
+    fprintf(stderr, "Failed to map sweep table %s: %s\n", table_path, strerror(errno));
+    return false;
+  }
+
+  size_t shared_size = sizeof(Queue) + count * sizeof(Slot) + size_t(job_count) * sizeof(std::atomic<uint32_t>);
+  void* shared = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  if (shared == MAP_FAILED) {
+    fprintf(stderr, "Failed to map sweep queue: %s\n", strerror(errno));
+    munmap(table, table_size);
+    return false;
+  }
+
+  // A fresh file is all zeroes, every row starts out SWEEP_PENDING
+  SweepTableHeader* header = static_cast<SweepTableHeader*>(table);
+  memcpy(header->magic, "GRAVSWP", 8);
+  header->version = SWEEP_TABLE_VERSION;
+  header->row_count = row_count;
+  header->row_size = sizeof(SweepResult);
+  header->value_count = SWEEP_RESULT_VALUES;
+
+  rows = reinterpret_cast<SweepResult*>(header + 1);
+
+  // Lock-free atomics are address-free, so they work across processes
+  queue = new (shared) Queue();
+  queue->next_job = 0;
+
+  slots = reinterpret_cast<Slot*>(queue + 1);
+
+  for (size_t i = 0; i < count; ++i) {
+    new (&slots[i]) Slot();
+    slots[i].job = SWEEP_NO_JOB;
+    slots[i].started = 0;
+  }
+
+  owners = reinterpret_cast<std::atomic<uint32_t>*>(slots + count);
+
+  for (uint32_t j = 0; j < job_count; ++j) {
+    new (&owners[j]) std::atomic<uint32_t>(SWEEP_UNCLAIMED);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  workers.assign(count, 0);
+  size_t live = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    spawn(i, SWEEP_NO_JOB, row_count, job);
+    live += workers[i] > 0;
+  }
+
+  while (live > 0) {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+
+    if (pid == 0) {
+      if (job_timeout > 0.0) {
+        int64_t now = monotonicNanoseconds();
+
+        for (size_t i = 0; i < count; ++i) {
+          if (workers[i] > 0 && slots[i].job != SWEEP_NO_JOB && double(now - slots[i].started) * 1e-9 > job_timeout) {
+            kill(workers[i], SIGKILL);
+          }
+        }
+      }
+
+      usleep(10000);
+      continue;
+    }
+
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      break;
+    }
+
+    size_t slot = 0;
+
+    while (slot < count && workers[slot] != pid) {
+      ++slot;
+    }
+
+    if (slot == count) {
+      continue;
+    }
+
+    workers[slot] = 0;
+    --live;
+
+    // Only the worker itself releases its claims, so whatever job it had is still marked
+    uint32_t crashed_job = SWEEP_NO_JOB;
+
+    for (uint32_t j = 0; j < job_count; ++j) {
+      if (owners[j] == slot) {
+        crashed_job = j;
+        break;
+      }
+    }
+
+    bool clean_exit = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    uint32_t retry = SWEEP_NO_JOB;
+
+    if (!clean_exit && crashed_job != SWEEP_NO_JOB) {
+      uint32_t first = crashed_job * batch_size;
+      uint32_t last = first + batch_size < row_count ? first + batch_size : row_count;
+
+      for (uint32_t i = first; i < last; ++i) {
+        // Died after claiming the job but before starting it, that's an attempt too
+        if (rows[i].worker != int32_t(pid)) {
+          rows[i].attempts += 1;
+          rows[i].worker = int32_t(pid);
+        }
+
+        rows[i].status = SWEEP_FAILED;
+        rows[i].signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+      }
+
+      // The retry goes to this slot again, which still owns the job
+      if (rows[first].attempts < max_attempts) {
+        retry = crashed_job;
+      } else {
+        owners[crashed_job] = SWEEP_RELEASED;
+      }
+    }
+
+    slots[slot].job = SWEEP_NO_JOB;
+
+    // A worker that died outside any job would most likely die again
+    bool work_left = retry != SWEEP_NO_JOB || ((clean_exit || crashed_job != SWEEP_NO_JOB) && queue->next_job < job_count);
+
+    if (work_left) {
+      spawn(slot, retry, row_count, job);
+      live += workers[slot] > 0;
+    }
+  }
+
+  // Jobs are released once done or given up on, the rest are still unclaimed or belong to a
+  // slot whose worker couldn't be forked again
+  uint32_t unfinished = 0;
+
+  for (uint32_t j = 0; j < job_count; ++j) {
+    unfinished += owners[j] != SWEEP_RELEASED;
+  }
+
+  if (unfinished > 0) {
+    fprintf(stderr, "%u of %u sweep jobs left unfinished, no worker could be forked for them\n", unfinished, job_count);
+  }
+
+  msync(table, table_size, MS_SYNC);
+  munmap(table, table_size);
+  munmap(shared, shared_size);
+
+  rows = nullptr;
+  queue = nullptr;
+  slots = nullptr;
+  owners = nullptr;
+
+  return unfinished == 0;
+}
+
+void SweepRunner::spawn(size_t slot, uint32_t first_job, uint32_t row_count, Job const& job) {
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    fprintf(stderr, "Failed to fork sweep worker: %s\n", strerror(errno));
+    workers[slot] = 0;
+    return;
+  }
+
+  if (pid == 0) {
+    // The pool's worker threads stayed in the parent, and the cores belong to the other workers
+    runSerially();
+
+    work(slot, first_job, row_count, job);
+
+    // Skip the parent's atexit handlers and static destructors, the thread pool among them
+    _exit(0);
+  }
+
+  workers[slot] = pid;
+}
+
+void SweepRunner::work(size_t slot, uint32_t first_job, uint32_t row_count, Job const& job) {
+  uint32_t job_count = uint32_t((uint64_t(row_count) + batch_size - 1) / batch_size);
+  uint32_t current = first_job;
+
+  while (true) {
+    if (current == SWEEP_NO_JOB) {
+      current = claim(slot, job_count);
+
+      if (current == SWEEP_NO_JOB) {
+        break;
+      }
+    }
+
+    uint32_t first = current * batch_size;
+    uint32_t count = first + batch_size < row_count ? batch_size : row_count - first;
+
+    for (uint32_t i = first; i < first + count; ++i) {
+      rows[i].status = SWEEP_RUNNING;
+      rows[i].attempts += 1;
+      rows[i].signal = 0;
+      rows[i].worker = int32_t(getpid());
+    }
+
+    slots[slot].started = monotonicNanoseconds();
+    slots[slot].job = current;
+
+    job(first, count, rows + first);
+
+    for (uint32_t i = first; i < first + count; ++i) {
+      if (rows[i].status == SWEEP_RUNNING) {
+        rows[i].status = SWEEP_DONE;
+      }
+    }
+
+    owners[current] = SWEEP_RELEASED;
+    slots[slot].job = SWEEP_NO_JOB;
+    current = SWEEP_NO_JOB;
+  }
+
+  fflush(stdout);
+}
+
+uint32_t SweepRunner::claim(size_t slot, uint32_t job_count) {
+  for (uint32_t j = queue->next_job; j < job_count; ++j) {
+    uint32_t unclaimed = SWEEP_UNCLAIMED;
+
+    if (owners[j].compare_exchange_strong(unclaimed, uint32_t(slot))) {
+      // Everything before j was claimed when we looked, and claims are never undone
+      uint32_t hint = queue->next_job;
+
+      while (hint < j + 1 && !queue->next_job.compare_exchange_weak(hint, j + 1)) {
+      }
+
+      return j;
+    }
+  }
+
+  // Saves the next workers the scan, and tells the parent the queue is empty
+  queue->next_job = job_count;
+
+  return SWEEP_NO_JOB;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+
+// fork() and shared mappings, there's no Windows version
+#ifndef _WIN32
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <sys/types.h>
+
+#define SWEEP_RESULT_VALUES ( 8 ) // Free-form values per row of the result table
+
+// SweepResult::status
+#define SWEEP_PENDING 0
+#define SWEEP_RUNNING 1
+#define SWEEP_DONE    2
+#define SWEEP_FAILED  3 // worker died or timed out on it, or the job gave up
+
+// One row of the result table, the table file is a SweepTableHeader and then the rows
+struct SweepResult {
+  uint32_t status;
+  uint32_t attempts;
+  int32_t  signal; // that killed the worker on the last attempt, 0 for none
+  int32_t  worker; // pid
+  uint64_t ticks;
+  double   values[SWEEP_RESULT_VALUES];
+};
+
+struct SweepTableHeader {
+  char     magic[8]; // "GRAVSWP"
+  uint32_t version;
+  uint32_t row_count;
+  uint32_t row_size;
+  uint32_t value_count;
+};
+
+// Runs jobs in forked headless worker processes, so a crashing or hanging job only costs its
+// worker. A job is batch_size consecutive rows of the table, so one can integrate many small
+// systems at once. Workers take jobs from a counter in shared memory and write their rows
+// straight into the memory-mapped result table. Dead workers are replaced, and the job they
+// were on is retried until it has had max_attempts
+class SweepRunner {
+public:
+  // Fills values and ticks of rows[0, count), which are table rows [first, first + count).
+  // May set a row's status to SWEEP_FAILED to give up on it
+  using Job = std::function<void(uint32_t first, uint32_t count, SweepResult* rows)>;
+
+  struct Slot {
+    std::atomic<uint32_t> job;     // SWEEP_NO_JOB when idle
+    std::atomic<int64_t>  started; // CLOCK_MONOTONIC nanoseconds
+  };
+
+  struct Queue {
+    std::atomic<uint32_t> next_job; // every job below it is claimed, a hint for where to look
+  };
+
+  uint32_t worker_count; // 0 for one per hardware thread
+  uint32_t max_attempts;
+  double   job_timeout;  // seconds, 0 for none
+  uint32_t batch_size;   // rows per job
+
+  Queue*       queue = nullptr;
+  Slot*        slots = nullptr;
+  SweepResult* rows = nullptr;
+
+  // Per job, the slot that claimed it, SWEEP_UNCLAIMED or SWEEP_RELEASED. Taking a job and
+  // recording who has it is one CAS, so a worker can't die holding a job nobody knows about
+  std::atomic<uint32_t>* owners = nullptr;
+
+  std::vector<pid_t> workers;
+
+public:
+  SweepRunner(uint32_t worker_count = 0, uint32_t max_attempts = 2, double job_timeout = 0.0, uint32_t batch_size = 1);
+
+public:
+  // Fills rows [0, row_count) of the table at table_path, batch_size at a time.
+  // False if the table or the shared queue couldn't be set up, or if jobs were left over
+  // because no worker could be forked for them
+  bool run(uint32_t row_count, char const* table_path, Job const& job);
+
+private:
+  void spawn(size_t slot, uint32_t first_job, uint32_t row_count, Job const& job);
+  void work(size_t slot, uint32_t first_job, uint32_t row_count, Job const& job);
+
+  // Next unclaimed job, now owned by slot, or SWEEP_NO_JOB when there are none left
+  uint32_t claim(size_t slot, uint32_t job_count);
+};
+
+#endif
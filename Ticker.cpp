@@ -19,3 +19,9 @@ uint32_t Ticker::tick() noexcept {
 
   return actual_ticks;
 }
+
+double Ticker::untilNextTick() const noexcept {
+  double remaining = (1.0 - ticks) * tick_period - (glfwGetTime() - previous_update);
+
+  return remaining > 0.0 ? remaining : 0.0;
+}
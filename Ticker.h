@@ -13,4 +13,7 @@ public:
 
 public:
   uint32_t tick() noexcept;
+
+  // Seconds left until tick() will report at least one tick
+  double untilNextTick() const noexcept;
 };
@@ -0,0 +1,54 @@
+#include "TreePM.h"
+
+#include <math.h>
+
+#include "Parallel.h"
+
+#define SHORT_RANGE_TABLE_SIZE ( 4096 )
+
+static constexpr double SQRT_PI = 1.7724538509055159;
+
+TreePM::TreePM(size_t grid_size, double box_size, double split_cells, double cutoff_splits)
+  : mesh(grid_size, box_size)
+{
+  split_radius = split_cells * mesh.cell_size;
+  cutoff_radius = cutoff_splits * split_radius;
+
+  tree.box_size = box_size;
+
+  double rs = split_radius;
+
+  mesh.setKernel([rs](double r) {
+    // erf(r / 2 r_s) / r goes to 1 / (r_s sqrt(pi)) at zero
+    if (r < 1e-9 * rs) {
+      return -1.0 / (rs * SQRT_PI);
+    }
+
+    return -erf(r / (2 * rs)) / r;
+  }, true);
+
+  short_range_table.resize(SHORT_RANGE_TABLE_SIZE);
+
+  for (size_t i = 0; i < SHORT_RANGE_TABLE_SIZE; ++i) {
+    double r = cutoff_radius * i / (SHORT_RANGE_TABLE_SIZE - 1);
+    double u = r / (2 * rs);
+
+    short_range_table[i] = erfc(u) + 2 * u / SQRT_PI * exp(-u * u);
+  }
+}
+
+void TreePM::apply(std::vector<Planet>& planets) {
+  // Wraps the planets into the box too, the tree is built after it
+  mesh.apply(planets);
+
+  tree.build(planets);
+
+  ShortRangeKernel kernel = { this };
+
+  parallelFor(planets.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Vector2d acceleration = tree.acceleration(static_cast<uint32_t>(i), kernel, cutoff_radius);
+      planets[i].punch(StateVector(acceleration * double(planets[i].mass)));
+    }
+  });
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "ParticleMesh.h"
+#include "QuadTree.h"
+
+// Newtonian force split with a Gaussian of scale split_radius:
+//   long range  - mesh with potential -erf(r / 2 r_s) / r, smooth on the grid scale
+//   short range - tree walk with force factor erfc(r / 2 r_s) + r / (r_s sqrt(pi)) exp(-r^2 / 4 r_s^2),
+//                 cells past cutoff_radius are never visited
+class TreePM {
+public:
+  ParticleMesh mesh;
+  QuadTree tree;
+
+  double split_radius;  // pixels
+  double cutoff_radius; // pixels
+
+  std::vector<double> short_range_table; // force factor sampled over [0, cutoff_radius]
+
+public:
+  TreePM(size_t grid_size, double box_size, double split_cells = 1.25, double cutoff_splits = 4.5);
+
+public:
+  void apply(std::vector<Planet>& planets);
+
+  struct ShortRangeKernel {
+    TreePM const* owner;
+
+    inline double operator()(double distance) const noexcept {
+      std::vector<double> const& table = owner->short_range_table;
+
+      double position = distance / owner->cutoff_radius * (table.size() - 1);
+      size_t index = static_cast<size_t>(position);
+
+      if (index + 1 >= table.size()) {
+        return 0.0;
+      }
+
+      double t = position - index;
+      return table[index] * (1 - t) + table[index + 1] * t;
+    }
+  };
+};
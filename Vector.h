@@ -2,70 +2,78 @@
 
 #include <math.h>
 
-struct Vector2 {
-  float x, y;
+template <typename T>
+struct TVector2 {
+  T x, y;
 
-  constexpr Vector2()
+  constexpr TVector2()
     : x(0), y(0) {}
 
-  explicit constexpr Vector2(float v)
+  explicit constexpr TVector2(T v)
     : x(v), y(v) {}
 
-  constexpr Vector2(float x, float y)
+  constexpr TVector2(T x, T y)
     : x(x), y(y) {}
 
-  inline float length() const noexcept {
-    return sqrtf( (x * x) + (y * y) );
+  template <typename U>
+  explicit constexpr TVector2(TVector2<U> const& v)
+    : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)) {}
+
+  inline T length() const noexcept {
+    return sqrt( (x * x) + (y * y) );
   }
 
-  inline Vector2 normalize() const noexcept {
-    float l = length();
-    return Vector2( x / l, y / l );
+  inline TVector2 normalize() const noexcept {
+    T l = length();
+    return TVector2( x / l, y / l );
   }
 
-  constexpr Vector2& operator+=(Vector2 const& v) noexcept {
+  constexpr TVector2& operator+=(TVector2 const& v) noexcept {
     x += v.x; y += v.y;
     return *this;
   }
 
-  constexpr Vector2 operator+(Vector2 const& v) const noexcept {
-    return Vector2( x + v.x, y + v.y );
+  constexpr TVector2 operator+(TVector2 const& v) const noexcept {
+    return TVector2( x + v.x, y + v.y );
   }
 
-  constexpr Vector2& operator-=(Vector2 const& v) noexcept {
+  constexpr TVector2& operator-=(TVector2 const& v) noexcept {
     x -= v.x; y -= v.y;
     return *this;
   }
 
-  constexpr Vector2 operator-(Vector2 const& v) const noexcept {
-    return Vector2( x - v.x, y - v.y );
+  constexpr TVector2 operator-(TVector2 const& v) const noexcept {
+    return TVector2( x - v.x, y - v.y );
   }
 
-  constexpr Vector2 operator*=(float scaler) noexcept {
+  constexpr TVector2 operator*=(T scaler) noexcept {
     x *= scaler; y *= scaler;
     return *this;
   }
 
-  constexpr Vector2 operator*(float scaler) const noexcept {
-    return Vector2( x * scaler, y * scaler );
+  constexpr TVector2 operator*(T scaler) const noexcept {
+    return TVector2( x * scaler, y * scaler );
   }
 
-  constexpr Vector2 operator/=(float scaler) noexcept {
+  constexpr TVector2 operator/=(T scaler) noexcept {
     x /= scaler; y /= scaler;
     return *this;
   }
 
-  constexpr Vector2 operator/(float scaler) const noexcept {
-    return Vector2( x / scaler, y / scaler );
+  constexpr TVector2 operator/(T scaler) const noexcept {
+    return TVector2( x / scaler, y / scaler );
   }
 
-  constexpr Vector2 operator-() const noexcept {
-    return Vector2( -x, -y );
+  constexpr TVector2 operator-() const noexcept {
+    return TVector2( -x, -y );
   }
 
-  constexpr bool operator==(Vector2 const& other) const noexcept {
+  constexpr bool operator==(TVector2 const& other) const noexcept {
     return
       x == other.x &&
       y == other.y;
   }
 };
+
+using Vector2  = TVector2<float>;
+using Vector2d = TVector2<double>;
@@ -0,0 +1,247 @@
+#include "WisdomHolman.h"
+
+#include <math.h>
+
+#include "Gravity.h"
+#include "Parallel.h"
+
+#define KEPLER_MAX_ITERATIONS ( 64 )
+#define KEPLER_TOLERANCE ( 1e-14 )
+
+// Stumpff functions c2(z) = (1 - cos(sqrt(z))) / z and c3(z) = (sqrt(z) - sin(sqrt(z))) / z^(3/2),
+// continued to z < 0 through cosh and sinh and replaced by their series near 0
+static void stumpff(double z, double& c2, double& c3) {
+  if (fabs(z) < 1e-2) {
+    c2 = 1.0 / 2 - z * (1.0 / 24 - z * (1.0 / 720 - z * (1.0 / 40320 - z / 3628800)));
+    c3 = 1.0 / 6 - z * (1.0 / 120 - z * (1.0 / 5040 - z * (1.0 / 362880 - z / 39916800)));
+  }
+  else if (z > 0.0) {
+    double root = sqrt(z);
+
+    c2 = (1.0 - cos(root)) / z;
+    c3 = (root - sin(root)) / (z * root);
+  }
+  else {
+    double root = sqrt(-z);
+
+    c2 = (cosh(root) - 1.0) / -z;
+    c3 = (sinh(root) - root) / (-z * root);
+  }
+}
+
+void keplerDrift(double mu, Vector2d& position, Vector2d& velocity, double dt) {
+  double r0 = position.length();
+
+  if (r0 == 0.0 || mu <= 0.0) {
+    position += velocity * dt;
+    return;
+  }
+
+  double sqrt_mu = sqrt(mu);
+
+  double v2 = velocity.x * velocity.x + velocity.y * velocity.y;
+  double radial = (position.x * velocity.x + position.y * velocity.y) / sqrt_mu; // r0 . v0 / sqrt(mu)
+
+  // Inverse semi-major axis, negative on hyperbolic orbits
+  double alpha = 2.0 / r0 - v2 / mu;
+
+  // Exact for circular orbits, close enough elsewhere
+  double chi = sqrt_mu * dt / r0;
+
+  if (alpha > 0.0) {
+    chi = sqrt_mu * dt * alpha;
+  }
+
+  double c2 = 0.0, c3 = 0.0;
+  double r = r0;
+
+  // Laguerre-Conway iterations on the universal Kepler equation, converge from any start
+  for (uint32_t iteration = 0; iteration < KEPLER_MAX_ITERATIONS; ++iteration) {
+    double chi2 = chi * chi;
+    stumpff(alpha * chi2, c2, c3);
+
+    double f = radial * chi2 * c2 + (1.0 - alpha * r0) * chi2 * chi * c3 + r0 * chi - sqrt_mu * dt;
+    double df = radial * chi * (1.0 - alpha * chi2 * c3) + (1.0 - alpha * r0) * chi2 * c2 + r0;
+    double ddf = radial * (1.0 - alpha * chi2 * c2) + (1.0 - alpha * r0) * chi * (1.0 - alpha * chi2 * c3);
+
+    r = df;
+
+    static constexpr double n = 5.0;
+    double discriminant = fabs((n - 1) * (n - 1) * df * df - n * (n - 1) * f * ddf);
+    double denominator = df + (df >= 0.0 ? 1.0 : -1.0) * sqrt(discriminant);
+
+    double delta = n * f / denominator;
+    chi -= delta;
+
+    if (fabs(delta) <= KEPLER_TOLERANCE * fabs(chi)) {
+      break;
+    }
+  }
+
+  double chi2 = chi * chi;
+  stumpff(alpha * chi2, c2, c3);
+
+  r = radial * chi * (1.0 - alpha * chi2 * c3) + (1.0 - alpha * r0) * chi2 * c2 + r0;
+
+  // Lagrange coefficients
+  double f = 1.0 - chi2 / r0 * c2;
+  double g = dt - chi2 * chi / sqrt_mu * c3;
+  double df = sqrt_mu / (r * r0) * chi * (alpha * chi2 * c3 - 1.0);
+  double dg = 1.0 - chi2 / r * c2;
+
+  Vector2d new_position = position * f + velocity * g;
+  Vector2d new_velocity = position * df + velocity * dg;
+
+  position = new_position;
+  velocity = new_velocity;
+}
+
+void WisdomHolman::step(std::vector<Planet>& planets, double dt) {
+  size_t count = planets.size();
+
+  if (count == 0) {
+    return;
+  }
+
+  central = 0;
+
+  for (size_t i = 1; i < count; ++i) {
+    if (planets[i].mass > planets[central].mass) {
+      central = static_cast<uint32_t>(i);
+    }
+  }
+
+  // Nothing to orbit, everything moves straight
+  if (planets[central].isTracer()) {
+    for (Planet& planet : planets) {
+      planet.move(planet.velocity * StateScalar(dt));
+    }
+
+    return;
+  }
+
+  positions.resize(count);
+  velocities.resize(count);
+  accelerations.resize(count);
+  masses.resize(count);
+
+  double total_mass = 0.0;
+  Vector2d weighted;
+  Vector2d momentum;
+
+  for (size_t i = 0; i < count; ++i) {
+    Planet const& planet = planets[i];
+
+    masses[i] = planet.mass;
+    positions[i] = Vector2d(planet.position);
+    velocities[i] = planet.isTracer() ? Vector2d(planet.velocity) : Vector2d(planet.velocity) / masses[i];
+
+    total_mass += masses[i];
+    weighted += positions[i] * masses[i];
+    momentum += velocities[i] * masses[i];
+  }
+
+  Vector2d barycenter = weighted / total_mass;
+  Vector2d barycenter_velocity = momentum / total_mass;
+
+  Vector2d center = positions[central];
+
+  for (size_t i = 0; i < count; ++i) {
+    positions[i] -= center;
+    velocities[i] -= barycenter_velocity;
+  }
+
+  jump(dt / 2);
+  kick(dt / 2);
+  drift(dt);
+  kick(dt / 2);
+  jump(dt / 2);
+
+  // Back to plain positions, the barycentre moves uniformly
+  barycenter += barycenter_velocity * dt;
+
+  Vector2d weighted_offset;
+  Vector2d others_momentum;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (i != central) {
+      weighted_offset += positions[i] * masses[i];
+      others_momentum += velocities[i] * masses[i];
+    }
+  }
+
+  center = barycenter - weighted_offset / total_mass;
+
+  for (size_t i = 0; i < count; ++i) {
+    Planet& planet = planets[i];
+
+    Vector2d position = i == central ? center : center + positions[i];
+    Vector2d velocity = i == central ? others_momentum / -masses[i] : velocities[i];
+
+    velocity += barycenter_velocity;
+
+    planet.position = PositionVector(position);
+    planet.velocity = StateVector(planet.isTracer() ? velocity : velocity * masses[i]);
+  }
+}
+
+// Kinetic energy of the centre, every other body shifts by the total momentum over its mass
+void WisdomHolman::jump(double dt) {
+  Vector2d momentum;
+
+  for (size_t i = 0; i < positions.size(); ++i) {
+    if (i != central) {
+      momentum += velocities[i] * masses[i];
+    }
+  }
+
+  Vector2d shift = momentum * (dt / masses[central]);
+
+  for (size_t i = 0; i < positions.size(); ++i) {
+    if (i != central) {
+      positions[i] += shift;
+    }
+  }
+}
+
+// Pulls between the bodies around the centre, the centre's own pull is in the drift
+void WisdomHolman::kick(double dt) {
+  size_t count = positions.size();
+
+  parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Vector2d acceleration;
+
+      if (i != central) {
+        for (size_t j = 0; j < count; ++j) {
+          if (j == i || j == central || masses[j] == 0.0) {
+            continue;
+          }
+
+          Vector2d diff = positions[j] - positions[i];
+          double distance = diff.length();
+
+          acceleration += diff * (G * masses[j] / (distance * distance * distance));
+        }
+      }
+
+      accelerations[i] = acceleration;
+    }
+  });
+
+  for (size_t i = 0; i < count; ++i) {
+    velocities[i] += accelerations[i] * dt;
+  }
+}
+
+void WisdomHolman::drift(double dt) {
+  double mu = G * masses[central];
+
+  parallelFor(positions.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (i != central) {
+        keplerDrift(mu, positions[i], velocities[i], dt);
+      }
+    }
+  });
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Planet.h"
+
+// Advances position and velocity by dt along the two body orbit around a fixed centre with
+// gravitational parameter mu. Universal variables, so any eccentricity works the same way
+void keplerDrift(double mu, Vector2d& position, Vector2d& velocity, double dt);
+
+// Wisdom-Holman map in democratic heliocentric coordinates (Duncan, Levison & Lee 1998).
+// The heaviest planet is the centre, every other body follows its exact Kepler orbit around it
+// and only the pulls between those bodies are integrated with kicks. Step:
+// jump(dt/2), kick(dt/2), Kepler drift(dt), kick(dt/2), jump(dt/2), symplectic and second order
+class WisdomHolman {
+public:
+  std::vector<Vector2d> positions;  // relative to the centre
+  std::vector<Vector2d> velocities; // relative to the barycentre
+  std::vector<Vector2d> accelerations;
+  std::vector<double> masses;       // 0 for tracers
+
+  uint32_t central = 0;
+
+public:
+  // Advances planets by dt ticks, forces included
+  void step(std::vector<Planet>& planets, double dt = 1.0);
+
+private:
+  void jump(double dt);
+  void kick(double dt);
+  void drift(double dt);
+};
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include <vector>
@@ -7,17 +9,117 @@
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 
+#include "FastMultipole.h"
+#include "Binaries.h"
+#include "Ensemble.h"
+#include "Gravity.h"
+#include "Hermite.h"
+#include "Morton.h"
+#include "Multigrid.h"
+#include "Parareal.h"
+#include "ParticleMesh.h"
 #include "Planet.h"
+#include "QuadTree.h"
+#include "RandomBatch.h"
+#include "Regularization.h"
+#include "Respa.h"
 #include "Rendering.h"
 #include "Ticker.h"
 #include "Shaders.h"
+#include "SmallSystem.h"
+#include "Sweep.h"
+#include "TreePM.h"
+#include "WisdomHolman.h"
 
-#define G ( 6.67430151515e-11 ) // Gravity constant
 #define SIMULATION_SPEED ( 40 ) // Ticks per second
+#define REBASE_PERIOD ( 200 )   // Ticks between origin rebases, 0 to disable
+
+// Set to 1 to rebase onto the camera focus instead of the centre of mass
+#define REBASE_ON_CAMERA 0
+
+// Id of the planet the camera follows (ids are the initial slots), -1 to follow the centre of mass
+#define CAMERA_FOLLOW ( -1 )
+
+#define MORTON_SORT_PERIOD ( 50 ) // Ticks between Z-order reorders of planets, 0 to disable
+
+// Force solver used by gravityTick()
+#define SOLVER_PAIRWISE      0 // exact n*n sum
+#define SOLVER_PARTICLE_MESH 1 // periodic box, see ParticleMesh.h
+#define SOLVER_TREE          2 // Barnes-Hut, see QuadTree.h
+#define SOLVER_TREE_PM       3 // periodic box, mesh long range + tree short range, see TreePM.h
+#define SOLVER_MULTIGRID     4 // open space mesh, see Multigrid.h
+#define SOLVER_FMM           5 // fast multipole method, see FastMultipole.h
+#define SOLVER_RANDOM_BATCH  6 // stochastic, forces only within random batches, see RandomBatch.h
+
+#define GRAVITY_SOLVER SOLVER_PAIRWISE
+
+#define MESH_GRID_SIZE ( 256 ) // Mesh cells per side, power of two
+#define MESH_BOX_SIZE ( 8192 ) // Side of the periodic box, pixels
+
+#define MULTIGRID_GRID_SIZE ( 128 ) // Multigrid cells per side, power of two
+
+#define TREE_MULTIPOLE_ORDER ( 2 ) // 1 monopole, 2 quadrupole, 3 octupole
+#define TREE_THETA ( 0.7 ) // Opening angle, higher orders allow larger ones
+
+#define FMM_ORDER ( 6 ) // Expansion order, error drops ~10x per two orders
+#define FMM_THETA ( 0.5 ) // Cells interact when (r_a + r_b) < theta * distance
+
+#define RANDOM_BATCH_SIZE ( 4 ) // Planets per batch, n * size work per tick
+#define RANDOM_BATCH_SEED ( 1 ) // Same seed, same run
+
+// How tick() advances the planets
+#define INTEGRATOR_EULER         0 // kick with GRAVITY_SOLVER, then drift
+#define INTEGRATOR_WISDOM_HOLMAN 1 // Kepler orbits around the heaviest planet, see WisdomHolman.h
+#define INTEGRATOR_HERMITE       2 // 4th order, individual block time steps, see Hermite.h
+#define INTEGRATOR_RESPA         3 // short range forces every inner step, GRAVITY_SOLVER once a tick, see Respa.h
+#define INTEGRATOR_PARAREAL      4 // Hermite parallel in time over spans of ticks, for few bodies, see Parareal.h
+
+#define INTEGRATOR INTEGRATOR_EULER
+
+// Bound pairs closer than this (pixels) move on Levi-Civita regularised orbits, 0 to disable,
+// 20 is a good start for close binaries. Euler integrator with SOLVER_PAIRWISE only, and not in
+// DOUBLE_FLOAT precision: the pair's pull is taken out again with applyGravity(), so the solver
+// must have used exactly that. See Regularization.h
+#define REGULARIZATION_RADIUS ( 0 )
+
+#if REGULARIZATION_RADIUS && (INTEGRATOR != INTEGRATOR_EULER || GRAVITY_SOLVER != SOLVER_PAIRWISE || SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT)
+#error REGULARIZATION_RADIUS needs the Euler integrator and SOLVER_PAIRWISE, outside DOUBLE_FLOAT precision
+#endif
+
+// Barely perturbed bound pairs whose orbit fits in this many pixels are merged into one body
+// for the force calculation, 0 to disable, 5 suits dense clusters. Euler integrator only,
+// see Binaries.h
+#define HARD_BINARY_RADIUS ( 0 )
+#define HARD_BINARY_PERTURBER_RADIUS ( 100 ) // Neighbours farther away don't count as perturbers
+
+// RESPA integrator only: pairs closer than the cutoff (pixels) are integrated with ticks split
+// into this many inner steps, the switch to long range starts at half the cutoff
+#define RESPA_INNER_STEPS ( 8 )
+#define RESPA_CUTOFF ( 50 )
+
+// Parareal integrator only: each span is PARAREAL_WINDOWS windows (0 for one per thread) of
+// PARAREAL_WINDOW_TICKS ticks, solved on a background thread while the previous span plays back.
+// Iterations stop once window starts move less than PARAREAL_TOLERANCE pixels
+#define PARAREAL_WINDOWS ( 0 )
+#define PARAREAL_WINDOW_TICKS ( 1000 )
+#define PARAREAL_TOLERANCE ( 1e-3 )
 
 // Set to 1 to debug renderer
 #define DEBUG_RENDERER 0
 
+// `gravisim --sweep <runs> <table file> [workers]` runs the default scenario headless once per
+// table row, with the orbit speed of its second planet spread over [MIN, MAX] times the usual one
+#define SWEEP_TICKS ( 100000 )
+#define SWEEP_SPEED_MIN ( 0.5 )
+#define SWEEP_SPEED_MAX ( 1.5 )
+#define SWEEP_JOB_TIMEOUT ( 600 ) // Seconds before a job's worker is killed, 0 for none
+#define SWEEP_BATCH ( 64 )        // Runs per job
+
+// The runs of a job go side by side through an Ensemble when that's the same physics as tick()
+#define SWEEP_ENSEMBLE ( \
+  INTEGRATOR == INTEGRATOR_EULER && GRAVITY_SOLVER == SOLVER_PAIRWISE && \
+  SIMULATION_PRECISION != PRECISION_DOUBLE_FLOAT && !REGULARIZATION_RADIUS && !HARD_BINARY_RADIUS )
+
 class GravitySimulation {
 public:
   std::vector<Planet> planets;
@@ -33,21 +135,78 @@ public:
 
   Renderer* render = nullptr;
 
+#if SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT
+  DoubleFloatGravity double_float_gravity;
+#endif
+
+  // Zero mass planets, solvers below see them as bodies without pull
+  TracerGravity tracer_gravity;
+
+#if INTEGRATOR == INTEGRATOR_WISDOM_HOLMAN
+  // Computes its own forces, GRAVITY_SOLVER is not used
+  WisdomHolman wisdom_holman;
+#elif INTEGRATOR == INTEGRATOR_HERMITE
+  // Computes its own forces and jerks, GRAVITY_SOLVER is not used
+  HermiteIntegrator hermite;
+#elif INTEGRATOR == INTEGRATOR_RESPA
+  // GRAVITY_SOLVER gives the long range forces
+  RespaIntegrator respa = RespaIntegrator(RESPA_INNER_STEPS, RESPA_CUTOFF);
+#elif INTEGRATOR == INTEGRATOR_PARAREAL
+  // Computes its own forces, GRAVITY_SOLVER is not used
+  Parareal parareal = Parareal(PARAREAL_WINDOWS, PARAREAL_WINDOW_TICKS, PARAREAL_TOLERANCE);
+#else
+#if REGULARIZATION_RADIUS
+  PairRegularization regularization = PairRegularization(REGULARIZATION_RADIUS);
+#endif
+#if HARD_BINARY_RADIUS
+  HardBinaries hard_binaries = HardBinaries(HARD_BINARY_RADIUS, HARD_BINARY_PERTURBER_RADIUS);
+#endif
+#endif
+
+#if GRAVITY_SOLVER == SOLVER_PARTICLE_MESH
+  ParticleMesh particle_mesh = ParticleMesh(MESH_GRID_SIZE, MESH_BOX_SIZE);
+#elif GRAVITY_SOLVER == SOLVER_TREE
+  QuadTree tree = QuadTree(TREE_MULTIPOLE_ORDER, TREE_THETA);
+#elif GRAVITY_SOLVER == SOLVER_TREE_PM
+  TreePM tree_pm = TreePM(MESH_GRID_SIZE, MESH_BOX_SIZE);
+#elif GRAVITY_SOLVER == SOLVER_MULTIGRID
+  MultigridGravity multigrid = MultigridGravity(MULTIGRID_GRID_SIZE);
+#elif GRAVITY_SOLVER == SOLVER_FMM
+  FastMultipole fast_multipole = FastMultipole(FMM_ORDER, FMM_THETA);
+#elif GRAVITY_SOLVER == SOLVER_RANDOM_BATCH
+  RandomBatch random_batch = RandomBatch(RANDOM_BATCH_SIZE, RANDOM_BATCH_SEED);
+#endif
+
+  // False while the window is iconified or hidden, nothing gets drawn then
+  bool visible = true;
+
+  // World position of the simulation (0, 0), planet positions are relative to it.
+  // Kept in double and moved now and then so positions stay small
+  Vector2d origin;
+  uint32_t ticks_since_rebase = 0;
+
+  // World position drawn at the centre of the window
+  Vector2d camera;
+
+  // Slots in planets change on every reorder, refer to planets from outside by id
+  MortonOrder morton_order;
+  uint32_t ticks_since_sort = 0;
+
 public:
   GravitySimulation() {
 #if DEBUG_RENDERER
     planets = {
-      Planet(Vector2(0.0, -300), 0, 200, 0xFF0000),
-      Planet(Vector2(0.0, 400), 0, 400, 0x00FF00),
-      Planet(Vector2(500, 300), 0, 100, 0x0000FF),
+      Planet(StateVector(0.0, -300), 0, 200, 0xFF0000),
+      Planet(StateVector(0.0, 400), 0, 400, 0x00FF00),
+      Planet(StateVector(500, 300), 0, 100, 0x0000FF),
     };
 #else
     planets = {
-      Planet(Vector2(0.0, 0.0), 5E14, 50, 0xFFFFFFFF),
-      Planet(Vector2(0.0, 600), 1E12, 20, 0xFFFF0000),
+      Planet(StateVector(0.0, 0.0), 5E14, 50, 0xFFFFFFFF),
+      Planet(StateVector(0.0, 600), 1E12, 20, 0xFFFF0000),
     };
 
-    planets[1].punch(Vector2(6E12, 0));
+    planets[1].punch(StateVector(6E12, 0));
 #endif
   }
 
@@ -59,10 +218,13 @@ public:
     glfwSetWindowUserPointer(window, this);
 
     glfwSetFramebufferSizeCallback(window, onFramebufferSizeChanged);
+    glfwSetWindowIconifyCallback(window, onWindowIconified);
+    glfwSetWindowFocusCallback(window, onWindowFocusChanged);
   }
 
   void run() {
     printf("Tick rate: %d\n", SIMULATION_SPEED);
+    printf("Precision: %s\n", PRECISION_NAME);
 
     double previous_frame_time = glfwGetTime();
 
@@ -102,6 +264,18 @@ public:
         tick();
       }
 
+      updateCamera();
+
+      if (!visible) {
+        // Nothing to present, sleep until the next tick is due or the window comes back
+#if DEBUG_RENDERER
+        glfwWaitEvents();
+#else
+        glfwWaitEventsTimeout(ticker.untilNextTick());
+#endif
+        continue;
+      }
+
       render->beginFrame();
       draw();
 
@@ -118,39 +292,333 @@ public:
   }
 
   void applyGravity(Planet& first, Planet& second) {
-    Vector2 diff = second.position - first.position;
+    // Difference is taken in state precision, everything after it in force precision
+    ForceVector diff = ForceVector(second.position - first.position);
+
+    ForceScalar distance = diff.length();
 
-    Vector2 direction = diff.normalize();
+    // Coincident planets have no direction to pull in
+    if (distance == ForceScalar(0)) {
+      return;
+    }
 
-    double distance = diff.length();
+    ForceVector direction = diff / distance;
 
-    double force = ( G * first.mass * second.mass ) / ( distance * distance );
+    ForceScalar force = ( ForceScalar(G) * ForceScalar(first.mass) * ForceScalar(second.mass) ) / ( distance * distance );
 
-    first.punch(direction * force);
-    second.punch(-direction * force);
+    first.punch(StateVector(direction * force));
+    second.punch(StateVector(-direction * force));
   }
 
   void gravityTick() {
-    size_t planets_count = planets.size();
+    tracer_gravity.split(planets);
+
+    // Tracers are neither sources nor targets of the solvers
+    std::vector<Planet>& sources = tracer_gravity.sources(planets);
+
+#if GRAVITY_SOLVER == SOLVER_PARTICLE_MESH
+    particle_mesh.apply(sources);
+#elif GRAVITY_SOLVER == SOLVER_TREE
+    tree.update(sources);
+    tree.apply(sources);
+#elif GRAVITY_SOLVER == SOLVER_TREE_PM
+    tree_pm.apply(sources);
+#elif GRAVITY_SOLVER == SOLVER_MULTIGRID
+    multigrid.apply(sources);
+#elif GRAVITY_SOLVER == SOLVER_FMM
+    fast_multipole.apply(sources);
+#elif GRAVITY_SOLVER == SOLVER_RANDOM_BATCH
+    random_batch.apply(sources);
+#elif SIMULATION_PRECISION == PRECISION_DOUBLE_FLOAT
+    double_float_gravity.apply(sources);
+#else
+    size_t count = sources.size();
 
-    for (size_t i = 0; i < planets_count; ++i) {
-      for (size_t j = i + 1; j < planets_count; ++j) {
-        applyGravity(planets[i], planets[j]);
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t j = i + 1; j < count; ++j) {
+        applyGravity(sources[i], sources[j]);
       }
     }
+#endif
+
+    tracer_gravity.gather(planets);
+    tracer_gravity.apply(planets);
   }
 
   void tick() {
-    gravityTick();
+#if INTEGRATOR == INTEGRATOR_WISDOM_HOLMAN
+    wisdom_holman.step(planets);
+#elif INTEGRATOR == INTEGRATOR_HERMITE
+    hermite.step(planets);
+#elif INTEGRATOR == INTEGRATOR_RESPA
+    respa.step(planets, [this] { gravityTick(); });
+#elif INTEGRATOR == INTEGRATOR_PARAREAL
+    parareal.step(planets);
+#else
+#if HARD_BINARY_RADIUS
+    hard_binaries.merge(planets, morton_order);
+#endif
+#if REGULARIZATION_RADIUS
+    regularization.begin(planets);
+#endif
+
+    bool ticked = false;
+
+#if GRAVITY_SOLVER == SOLVER_PAIRWISE && SIMULATION_PRECISION != PRECISION_DOUBLE_FLOAT
+    // Unrolled kernels for up to SMALL_SYSTEM_MAX planets, same result as below
+    ticked = smallSystemTick(planets);
+#endif
+
+    if (!ticked) {
+      gravityTick();
+
+      for (Planet& planet : planets) {
+        planet.tick();
+      }
+    }
+
+#if REGULARIZATION_RADIUS
+    regularization.end(planets, [this](Planet& first, Planet& second) { applyGravity(first, second); });
+#endif
+#if HARD_BINARY_RADIUS
+    hard_binaries.split(planets, morton_order);
+#endif
+#endif
+
+#if REBASE_PERIOD
+    if (++ticks_since_rebase >= REBASE_PERIOD) {
+      rebase();
+      ticks_since_rebase = 0;
+    }
+#endif
+
+// Parareal plays back whole spans in the slot order they were solved in
+#if MORTON_SORT_PERIOD && INTEGRATOR != INTEGRATOR_PARAREAL
+    if (++ticks_since_sort >= MORTON_SORT_PERIOD) {
+      morton_order.reorder(planets);
+      ticks_since_sort = 0;
+
+#if GRAVITY_SOLVER == SOLVER_TREE
+      // Tree cells refer to planets by slot
+      tree.invalidate();
+#endif
+#if INTEGRATOR == INTEGRATOR_HERMITE
+      // Block steps stay with their planets, hard binaries find theirs by id
+      hermite.reorder(morton_order.permutation);
+#elif INTEGRATOR == INTEGRATOR_RESPA
+      respa.invalidate();
+#endif
+    }
+#endif
+  }
+
+  Vector2d centerOfMass() const {
+    Vector2d weighted;
+    double total_mass = 0.0;
+
+    for (Planet const& planet : planets) {
+      weighted += Vector2d(planet.position) * planet.mass;
+      total_mass += planet.mass;
+    }
+
+    return total_mass > 0.0 ? weighted / total_mass : Vector2d();
+  }
+
+  double totalEnergy() const {
+    double kinetic = 0.0, potential = 0.0;
+
+    for (size_t i = 0; i < planets.size(); ++i) {
+      Planet const& first = planets[i];
+
+      // Tracers carry neither
+      if (first.isTracer()) {
+        continue;
+      }
+
+      Vector2d momentum = Vector2d(first.velocity);
+      kinetic += 0.5 * (momentum.x * momentum.x + momentum.y * momentum.y) / first.mass;
+
+      for (size_t j = i + 1; j < planets.size(); ++j) {
+        double distance = (Vector2d(planets[j].position) - Vector2d(first.position)).length();
+
+        if (distance > 0.0) {
+          potential -= G * first.mass * planets[j].mass / distance;
+        }
+      }
+    }
+
+    return kinetic + potential;
+  }
+
+#ifndef _WIN32
+  // Some planet ran off to infinity or NaN
+  bool diverged() const {
+    Vector2d center = centerOfMass();
+    return !isfinite(center.x) || !isfinite(center.y);
+  }
+
+  // Headless run for --sweep, nothing here touches the window. Values are the speed factor,
+  // the relative energy error and the largest distance from the centre of mass at the end
+  void sweep(double speed, uint64_t ticks, SweepResult& result) {
+#if INTEGRATOR == INTEGRATOR_PARAREAL
+    // There's no frame to keep smooth, every tick has to move the planets
+    parareal.blocking = true;
+#endif
+
+    planets[1].velocity = planets[1].velocity * StateScalar(speed);
+
+    double initial_energy = totalEnergy();
+
+    result.values[0] = speed;
+
+    for (uint64_t i = 0; i < ticks; ++i) {
+      tick();
+      result.ticks = i + 1;
+
+      // A diverged run only gets slower from here
+      if (i % 1000 == 0 && diverged()) {
+        result.status = SWEEP_FAILED;
+        return;
+      }
+    }
+
+    double energy = totalEnergy();
+
+    if (!isfinite(energy)) {
+      result.status = SWEEP_FAILED;
+      return;
+    }
+
+    result.values[1] = initial_energy != 0.0 ? (energy - initial_energy) / fabs(initial_energy) : 0.0;
+
+    Vector2d center = centerOfMass();
+    double farthest = 0.0;
+
+    for (Planet const& planet : planets) {
+      farthest = fmax(farthest, (Vector2d(planet.position) - center).length());
+    }
+
+    result.values[2] = farthest;
+  }
+
+#if SWEEP_ENSEMBLE
+  // Same as sweep() for count runs at once, planets are left as the last run ended.
+  // False, with nothing filled, if the scenario doesn't fit an Ensemble
+  bool sweepEnsemble(double const* speeds, size_t count, uint64_t ticks, SweepResult* results) {
+    std::vector<Planet> initial = planets;
+    Ensemble ensemble = Ensemble(planets.size(), count);
+
+    for (size_t m = 0; m < count; ++m) {
+      planets = initial;
+      planets[1].velocity = planets[1].velocity * StateScalar(speeds[m]);
+
+      if (!ensemble.set(m, planets)) {
+        planets = initial;
+        return false;
+      }
+    }
+
+    for (size_t m = 0; m < count; ++m) {
+      results[m].values[0] = speeds[m];
+    }
+
+    // Members can't stop on their own, a diverged one is failed where it was found and just
+    // rides along with the others. Checked as often as sweep() does
+    size_t live = count;
+
+    for (uint64_t done = 0; done < ticks && live > 0;) {
+      uint64_t chunk = ticks - done < 1000 ? ticks - done : 1000;
+
+      ensemble.tick(chunk);
+      done += chunk;
+
+      for (size_t m = 0; m < count; ++m) {
+        if (results[m].status == SWEEP_FAILED) {
+          continue;
+        }
+
+        ensemble.get(m, planets);
+        results[m].ticks = done;
+
+        if (diverged()) {
+          results[m].status = SWEEP_FAILED;
+          --live;
+        }
+      }
+    }
+
+    for (size_t m = 0; m < count; ++m) {
+      if (results[m].status == SWEEP_FAILED) {
+        continue;
+      }
+
+      Ensemble::Diagnostics diagnostics = ensemble.diagnostics(m);
+      ensemble.get(m, planets);
+
+      if (!isfinite(diagnostics.energy)) {
+        results[m].status = SWEEP_FAILED;
+        continue;
+      }
+
+      results[m].values[1] = diagnostics.energy_error;
+
+      Vector2d center = centerOfMass();
+      double farthest = 0.0;
+
+      for (Planet const& planet : planets) {
+        farthest = fmax(farthest, (Vector2d(planet.position) - center).length());
+      }
+
+      results[m].values[2] = farthest;
+    }
+
+    return true;
+  }
+#endif
+#endif
+
+  // Moves the origin to the centre of mass (or camera) and shifts all positions back by the same amount
+  void rebase() {
+#if REBASE_ON_CAMERA
+    Vector2d shift = camera - origin;
+#else
+    Vector2d shift = centerOfMass();
+#endif
 
     for (Planet& planet : planets) {
-      planet.tick();
+      planet.move(StateVector(-shift));
     }
+
+#if INTEGRATOR == INTEGRATOR_PARAREAL
+    parareal.move(-shift);
+#endif
+
+    origin += shift;
+  }
+
+  Vector2d worldPosition(Planet const& planet) const {
+    return origin + Vector2d(planet.position);
+  }
+
+  void updateCamera() {
+#if CAMERA_FOLLOW >= 0
+    // Slots change on reorders, the id stays with the planet
+    morton_order.track(planets.size());
+
+    if (uint32_t(CAMERA_FOLLOW) < planets.size()) {
+      camera = worldPosition(morton_order.planet(planets, CAMERA_FOLLOW));
+    }
+#else
+    camera = origin + centerOfMass();
+#endif
   }
 
   void draw() {
+    // Large parts cancel here in double, the renderer only sees the small remainder
+    Vector2d view_offset = origin - camera;
+
     for (Planet const& planet : planets) {
-      Vector2 pos = planet.position;
+      Vector2 pos = Vector2(Vector2d(planet.position) + view_offset);
       uint32_t color = planet.color;
       float radius = planet.radius;
     
@@ -164,9 +632,73 @@ public:
 
     app->render->setViewport(Vector2(width, height));
   }
+
+  static void onWindowIconified(GLFWwindow* window, int iconified) {
+    GravitySimulation* app = (GravitySimulation*)glfwGetWindowUserPointer(window);
+
+    app->visible = !iconified;
+  }
+
+  static void onWindowFocusChanged(GLFWwindow* window, int) {
+    GravitySimulation* app = (GravitySimulation*)glfwGetWindowUserPointer(window);
+
+    // Not every window manager reports iconify/restore, but all of them move the focus
+    app->updateVisibility();
+  }
+
+  void updateVisibility() {
+    visible =
+      !glfwGetWindowAttrib(window, GLFW_ICONIFIED) &&
+       glfwGetWindowAttrib(window, GLFW_VISIBLE);
+  }
 };
 
-int main() {
+#ifndef _WIN32
+static int runSweep(uint32_t run_count, char const* table_path, uint32_t worker_count) {
+  SweepRunner runner = SweepRunner(worker_count, 2, SWEEP_JOB_TIMEOUT, SWEEP_BATCH);
+
+  bool ok = runner.run(run_count, table_path, [run_count](uint32_t first, uint32_t count, SweepResult* rows) {
+    std::vector<double> speeds = std::vector<double>(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+      double t = run_count > 1 ? double(first + i) / (run_count - 1) : 0.0;
+      speeds[i] = SWEEP_SPEED_MIN + (SWEEP_SPEED_MAX - SWEEP_SPEED_MIN) * t;
+    }
+
+#if SWEEP_ENSEMBLE
+    GravitySimulation* batch = new GravitySimulation();
+    bool batched = batch->sweepEnsemble(speeds.data(), count, SWEEP_TICKS, rows);
+    delete batch;
+
+    if (batched) {
+      return;
+    }
+#endif
+
+    for (uint32_t i = 0; i < count; ++i) {
+      GravitySimulation* app = new GravitySimulation();
+      app->sweep(speeds[i], SWEEP_TICKS, rows[i]);
+      delete app;
+    }
+  });
+
+  if (!ok) {
+    return 1;
+  }
+
+  printf("Sweep of %u runs written to %s\n", run_count, table_path);
+
+  return 0;
+}
+#endif
+
+int main(int argc, char** argv) {
+#ifndef _WIN32
+  if (argc >= 4 && strcmp(argv[1], "--sweep") == 0) {
+    return runSweep(uint32_t(atoi(argv[2])), argv[3], argc >= 5 ? uint32_t(atoi(argv[4])) : 0);
+  }
+#endif
+
   GravitySimulation* app = new GravitySimulation();
 
   app->init();
@@ -0,0 +1,86 @@
+// Sweep jobs that call parallelFor() from a thread of their own, the way Parareal's solver does,
+// must run serially in the forked worker instead of waiting on pool threads left in the parent
+
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+
+#include "Parallel.h"
+#include "Sweep.h"
+
+#define TEST_TABLE "sweep_fork_test.bin"
+#define TEST_ROWS ( 4 )
+#define TEST_COUNT ( 1000 )
+
+int main() {
+  // The parent's pool is up and has been used before the fork
+  std::atomic<uint64_t> warmup = 0;
+
+  parallelFor(TEST_COUNT, [&](size_t begin, size_t end) {
+    warmup += end - begin;
+  });
+
+  SweepRunner runner = SweepRunner(2, 1, 10.0);
+
+  bool ok = runner.run(TEST_ROWS, TEST_TABLE, [](uint32_t, uint32_t count, SweepResult* rows) {
+    for (uint32_t i = 0; i < count; ++i) {
+      std::atomic<uint64_t> sum = 0;
+
+      std::thread thread = std::thread([&] {
+        parallelFor(TEST_COUNT, [&](size_t begin, size_t end) {
+          for (size_t k = begin; k < end; ++k) {
+            sum += k;
+          }
+        });
+      });
+
+      thread.join();
+
+      rows[i].values[0] = double(sum);
+      rows[i].values[1] = double(threadCount());
+    }
+  });
+
+  if (!ok) {
+    fprintf(stderr, "Sweep failed\n");
+    return 1;
+  }
+
+  FILE* file = fopen(TEST_TABLE, "rb");
+
+  if (!file) {
+    fprintf(stderr, "Failed to open %s\n", TEST_TABLE);
+    return 1;
+  }
+
+  SweepTableHeader header;
+  SweepResult row;
+  int failures = 0;
+
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.row_count != TEST_ROWS) {
+    fprintf(stderr, "Bad table header\n");
+    fclose(file);
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < TEST_ROWS; ++i) {
+    if (fread(&row, sizeof(row), 1, file) != 1) {
+      fprintf(stderr, "Row %u missing\n", i);
+      ++failures;
+      break;
+    }
+
+    double expected = double(TEST_COUNT) * (TEST_COUNT - 1) / 2;
+
+    if (row.status != SWEEP_DONE || row.values[0] != expected || row.values[1] != 1.0) {
+      fprintf(stderr, "Row %u: status %u signal %d sum %g threads %g\n", i, row.status, row.signal, row.values[0], row.values[1]);
+      ++failures;
+    }
+  }
+
+  fclose(file);
+  remove(TEST_TABLE);
+
+  return failures == 0 ? 0 : 1;
+}